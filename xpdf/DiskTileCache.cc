@@ -0,0 +1,378 @@
+//========================================================================
+//
+// DiskTileCache.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <vector>
+#include <goo/GooString.h>
+#include <splash/SplashBitmap.h>
+#include "gfile-xpdf.h"
+#include "DiskTileCache.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Tile file header: magic number, followed by width, height, color
+// mode, row size, alpha flag, and the compressed sizes of the color
+// and alpha data.  Everything is stored in native byte order -- the
+// cache is never shared between machines.
+#define tileFileMagic 0x58504454	// "XPDT"
+#define tileFileHdrLen 8
+
+// Amount of data hashed from each of the start, middle, and end of a
+// document to identify it.
+#define docHashChunkSize 65536
+
+// When the cache is over its limit, it is trimmed to this fraction of
+// the limit, so it isn't trimmed again on every store.
+#define trimTarget 0.75
+
+//------------------------------------------------------------------------
+// DiskTileCache
+//------------------------------------------------------------------------
+
+DiskTileCache::DiskTileCache(SplashColorMode colorModeA, int bitmapRowPadA,
+			     SplashColorPtr paperColorA, long long maxSizeA) {
+  const char *s;
+
+  colorMode = colorModeA;
+  bitmapRowPad = bitmapRowPadA;
+  splashColorCopy(paperColor, paperColorA);
+  maxSize = maxSizeA;
+  curSize = 0;
+  sizeKnown = false;
+  trimming = false;
+  if (maxSize > 0) {
+    if ((s = getenv("XDG_CACHE_HOME")) && s[0]) {
+      cacheDir = s;
+    } else {
+      GooString *home = getHomeDir();
+      cacheDir = toString(home);
+      cacheDir += "/.cache";
+      delete home;
+    }
+    cacheDir += "/xpdf";
+  }
+}
+
+DiskTileCache::~DiskTileCache() {
+}
+
+void DiskTileCache::setDoc(const std::string& fileName) {
+  unsigned long long h;
+  char buf[64];
+  std::string dir;
+
+  if (!cacheDir.empty() && hashFile(fileName, &h)) {
+    // the color settings are part of the directory name, since they
+    // apply to every tile
+    snprintf(buf, sizeof(buf), "/%016llx-%d-%02x%02x%02x%02x",
+	     h, (int)colorMode, paperColor[0], paperColor[1],
+	     paperColor[2], paperColor[3]);
+    dir = cacheDir + buf;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  docDir = dir;
+}
+
+void DiskTileCache::clearDoc() {
+  std::lock_guard<std::mutex> lock(mutex);
+  docDir.clear();
+}
+
+// Hash the size of the file, plus a chunk from the start, middle, and
+// end of it (FNV-1a).  Reading the whole file would make opening a
+// large document noticeably slower; since an edited PDF either changes
+// length or gets a new trailer ID, this is enough to tell versions
+// apart.
+bool DiskTileCache::hashFile(const std::string& fileName,
+			     unsigned long long *h) {
+  FILE *f;
+  struct stat st;
+  unsigned char buf[docHashChunkSize];
+  long long size, offsets[3];
+  size_t n, j;
+  int i;
+
+  if (!(f = fopen(fileName.c_str(), "rb"))) {
+    return false;
+  }
+  if (fstat(fileno(f), &st) || !S_ISREG(st.st_mode)) {
+    fclose(f);
+    return false;
+  }
+  size = (long long)st.st_size;
+  *h = 0xcbf29ce484222325ULL;
+  for (i = 0; i < 8; ++i) {
+    *h = (*h ^ ((size >> (8 * i)) & 0xff)) * 0x100000001b3ULL;
+  }
+  offsets[0] = 0;
+  offsets[1] = size / 2;
+  offsets[2] = size - docHashChunkSize;
+  for (i = 0; i < 3; ++i) {
+    if (offsets[i] < 0) {
+      offsets[i] = 0;
+    }
+    if (fseeko(f, (off_t)offsets[i], SEEK_SET)) {
+      fclose(f);
+      return false;
+    }
+    n = fread(buf, 1, sizeof(buf), f);
+    for (j = 0; j < n; ++j) {
+      *h = (*h ^ buf[j]) * 0x100000001b3ULL;
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+std::string DiskTileCache::getTileFile(int page, double dpi, int rotate,
+				       int x, int y, int w, int h,
+				       bool reverseVideo) {
+  char buf[128];
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (docDir.empty()) {
+    return std::string();
+  }
+  snprintf(buf, sizeof(buf), "/p%d-r%d-d%ld-%d-%d-%dx%d%s",
+	   page, rotate, (long)(dpi * 1000 + 0.5), x, y, w, h,
+	   reverseVideo ? "-rv" : "");
+  return docDir + buf;
+}
+
+SplashBitmap *DiskTileCache::load(const std::string& tileFile) {
+  std::vector<unsigned char> buf;
+  struct stat st;
+  unsigned int hdr[tileFileHdrLen];
+  SplashBitmap *bitmap;
+  uLongf len;
+  size_t pos;
+  ssize_t n;
+  int fd;
+
+  if (tileFile.empty()) {
+    return NULL;
+  }
+  if ((fd = open(tileFile.c_str(), O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(hdr)) {
+    close(fd);
+    return NULL;
+  }
+  buf.resize(st.st_size);
+  for (pos = 0; pos < buf.size(); pos += n) {
+    if ((n = read(fd, buf.data() + pos, buf.size() - pos)) <= 0) {
+      close(fd);
+      return NULL;
+    }
+  }
+  // bump the modification time -- it's used as the LRU timestamp
+  futimens(fd, NULL);
+  close(fd);
+
+  memcpy(hdr, buf.data(), sizeof(hdr));
+  if (hdr[0] != tileFileMagic || hdr[3] != (unsigned int)colorMode ||
+      sizeof(hdr) + (size_t)hdr[6] + (size_t)hdr[7] != buf.size()) {
+    return NULL;
+  }
+  bitmap = new SplashBitmap((int)hdr[1], (int)hdr[2], bitmapRowPad,
+			    colorMode, hdr[5] != 0);
+  if ((unsigned int)bitmap->getRowSize() != hdr[4]) {
+    delete bitmap;
+    return NULL;
+  }
+  pos = sizeof(hdr);
+  len = (uLongf)bitmap->getRowSize() * bitmap->getHeight();
+  if (uncompress(bitmap->getDataPtr(), &len, buf.data() + pos,
+		 hdr[6]) != Z_OK ||
+      len != (uLongf)bitmap->getRowSize() * bitmap->getHeight()) {
+    delete bitmap;
+    return NULL;
+  }
+  pos += hdr[6];
+  if (hdr[5]) {
+    len = (uLongf)bitmap->getWidth() * bitmap->getHeight();
+    if (uncompress(bitmap->getAlphaPtr(), &len, buf.data() + pos,
+		   hdr[7]) != Z_OK ||
+	len != (uLongf)bitmap->getWidth() * bitmap->getHeight()) {
+      delete bitmap;
+      return NULL;
+    }
+  }
+  return bitmap;
+}
+
+void DiskTileCache::store(const std::string& tileFile, SplashBitmap *bitmap) {
+  std::vector<unsigned char> data, alpha;
+  unsigned int hdr[tileFileHdrLen];
+  struct stat st;
+  std::string dir, tmpFile;
+  uLongf dataLen, alphaLen;
+  long long oldSize, startSize, total;
+  size_t i;
+  bool ok;
+  int fd;
+
+  if (tileFile.empty() || !bitmap) {
+    return;
+  }
+
+  // compress
+  dataLen = compressBound((uLong)bitmap->getRowSize() * bitmap->getHeight());
+  data.resize(dataLen);
+  if (compress2(data.data(), &dataLen, bitmap->getDataPtr(),
+		(uLong)bitmap->getRowSize() * bitmap->getHeight(),
+		Z_BEST_SPEED) != Z_OK) {
+    return;
+  }
+  alphaLen = 0;
+  if (bitmap->getAlphaPtr()) {
+    alphaLen = compressBound((uLong)bitmap->getWidth() * bitmap->getHeight());
+    alpha.resize(alphaLen);
+    if (compress2(alpha.data(), &alphaLen, bitmap->getAlphaPtr(),
+		  (uLong)bitmap->getWidth() * bitmap->getHeight(),
+		  Z_BEST_SPEED) != Z_OK) {
+      return;
+    }
+  }
+  hdr[0] = tileFileMagic;
+  hdr[1] = (unsigned int)bitmap->getWidth();
+  hdr[2] = (unsigned int)bitmap->getHeight();
+  hdr[3] = (unsigned int)bitmap->getMode();
+  hdr[4] = (unsigned int)bitmap->getRowSize();
+  hdr[5] = bitmap->getAlphaPtr() ? 1 : 0;
+  hdr[6] = (unsigned int)dataLen;
+  hdr[7] = (unsigned int)alphaLen;
+
+  // write to a temporary file, then rename it into place, so a reader
+  // never sees a partial tile
+  dir = tileFile.substr(0, tileFile.rfind('/'));
+  for (i = dir.find('/', 1); i != std::string::npos; i = dir.find('/', i + 1)) {
+    mkdir(dir.substr(0, i).c_str(), 0700);
+  }
+  mkdir(dir.c_str(), 0700);
+  tmpFile = dir + "/tmpXXXXXX";
+  if ((fd = mkstemp(&tmpFile[0])) < 0) {
+    return;
+  }
+  ok = write(fd, hdr, sizeof(hdr)) == (ssize_t)sizeof(hdr) &&
+       write(fd, data.data(), dataLen) == (ssize_t)dataLen &&
+       (alphaLen == 0 ||
+	write(fd, alpha.data(), alphaLen) == (ssize_t)alphaLen);
+  ok = close(fd) == 0 && ok;
+  if (!ok) {
+    unlink(tmpFile.c_str());
+    return;
+  }
+
+  if (!stat(tileFile.c_str(), &st)) {
+    oldSize = (long long)st.st_size;
+  } else {
+    oldSize = 0;
+  }
+  if (rename(tmpFile.c_str(), tileFile.c_str())) {
+    unlink(tmpFile.c_str());
+    return;
+  }
+
+  // only the size accounting is done with the mutex held -- scanning
+  // and trimming the cache directory can take a while, and mustn't
+  // hold up getTileFile() in the UI thread; one thread at a time does
+  // it, and stores made meanwhile are added on afterward
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    curSize += (long long)(sizeof(hdr) + dataLen + alphaLen) - oldSize;
+    if (trimming || (sizeKnown && curSize <= maxSize)) {
+      return;
+    }
+    trimming = true;
+    startSize = curSize;
+  }
+  total = trim();
+  std::lock_guard<std::mutex> lock(mutex);
+  curSize = total + (curSize - startSize);
+  sizeKnown = true;
+  trimming = false;
+}
+
+// Add up the size of everything in the cache, and if it's over the
+// limit, delete the least recently used tiles, across all documents,
+// until it's back under.  Returns the resulting size.  Called without
+// the mutex held.
+long long DiskTileCache::trim() {
+  struct CacheFile {
+    time_t mtime;
+    long long size;
+    std::string path;
+  };
+  std::vector<CacheFile> files;
+  std::vector<std::string> dirs;
+  DIR *topDir, *subDir;
+  struct dirent *ent, *subEnt;
+  struct stat st;
+  std::string path, subPath;
+  long long total;
+
+  total = 0;
+  if (!(topDir = opendir(cacheDir.c_str()))) {
+    return total;
+  }
+  while ((ent = readdir(topDir))) {
+    if (ent->d_name[0] == '.') {
+      continue;
+    }
+    path = cacheDir + "/" + ent->d_name;
+    if (!(subDir = opendir(path.c_str()))) {
+      continue;
+    }
+    dirs.push_back(path);
+    while ((subEnt = readdir(subDir))) {
+      subPath = path + "/" + subEnt->d_name;
+      if (subEnt->d_name[0] != '.' &&
+	  !stat(subPath.c_str(), &st) && S_ISREG(st.st_mode)) {
+	files.push_back({st.st_mtime, (long long)st.st_size, subPath});
+	total += (long long)st.st_size;
+      }
+    }
+    closedir(subDir);
+  }
+  closedir(topDir);
+  if (total <= maxSize) {
+    return total;
+  }
+
+  std::sort(files.begin(), files.end(),
+	    [](const CacheFile& a, const CacheFile& b) {
+	      return a.mtime < b.mtime;
+	    });
+  for (auto& file: files) {
+    if (total <= (long long)(maxSize * trimTarget)) {
+      break;
+    }
+    if (!unlink(file.path.c_str())) {
+      total -= file.size;
+    }
+  }
+
+  // remove directories that are now empty (this fails harmlessly for
+  // the others)
+  for (auto& dir: dirs) {
+    rmdir(dir.c_str());
+  }
+  return total;
+}
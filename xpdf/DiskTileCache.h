@@ -0,0 +1,81 @@
+//========================================================================
+//
+// DiskTileCache.h
+//
+// A persistent cache of rendered tiles, kept on disk between runs.
+//
+//========================================================================
+
+#ifndef DISKTILECACHE_H
+#define DISKTILECACHE_H
+
+#include <poppler-config.h>
+
+#include <mutex>
+#include <string>
+#include <splash/SplashTypes.h>
+#include "config.h"
+
+class SplashBitmap;
+
+//------------------------------------------------------------------------
+// DiskTileCache
+//------------------------------------------------------------------------
+
+// Tiles are stored zlib-compressed, one per file, under
+// $XDG_CACHE_HOME/xpdf (or ~/.cache/xpdf), in a directory per
+// document.  Documents are identified by a hash of their contents
+// rather than their name, so a renamed or copied file still hits the
+// cache, and a modified one doesn't.  When the cache grows past its
+// size limit, the least recently used tiles are deleted.
+//
+// load() and store() may be called from any thread.
+class DiskTileCache {
+public:
+
+  // Create a cache limited to <maxSizeA> bytes.  If <maxSizeA> is
+  // zero, the cache is disabled.
+  DiskTileCache(SplashColorMode colorModeA, int bitmapRowPadA,
+		SplashColorPtr paperColorA, long long maxSizeA);
+  ~DiskTileCache();
+
+  // Set the document that tiles will be looked up for.
+  void setDoc(const std::string& fileName);
+
+  // Forget the current document.
+  void clearDoc();
+
+  // Return the name of the file that holds a tile of the current
+  // document, or an empty string if the cache is disabled (or there
+  // is no document).
+  std::string getTileFile(int page, double dpi, int rotate,
+			  int x, int y, int w, int h, bool reverseVideo);
+
+  // Read a tile.  Returns NULL if it isn't in the cache (or the file
+  // is unusable).
+  SplashBitmap *load(const std::string& tileFile);
+
+  // Write a tile.
+  void store(const std::string& tileFile, SplashBitmap *bitmap);
+
+private:
+
+  static bool hashFile(const std::string& fileName, unsigned long long *h);
+  long long trim();
+
+  SplashColorMode colorMode;
+  int bitmapRowPad;
+  SplashColor paperColor;
+  long long maxSize;		// size limit, in bytes
+  std::string cacheDir;		// top-level cache directory
+
+  std::mutex mutex;		// protects everything below
+  std::string docDir;		// directory for the current document
+  long long curSize;		// total size of the cache, in bytes (only
+				//   what this process has stored, until
+				//   sizeKnown is set)
+  bool sizeKnown;		// set once the cache has been scanned
+  bool trimming;		// set while a thread is in trim()
+};
+
+#endif
@@ -0,0 +1,153 @@
+//========================================================================
+//
+// MappedFileStream.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <goo/GooString.h>
+#include "Object.h"
+#include "MappedFileStream.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Amount at the end of the file to read ahead as soon as it's mapped:
+// that's where the trailer and (usually) the xref table are.
+#define mappedFileTailSize (1024 * 1024)
+
+//------------------------------------------------------------------------
+// MappedFile
+//------------------------------------------------------------------------
+
+// All current mappings, by device and inode.
+static std::mutex mappedFilesMutex;
+static std::map<std::pair<unsigned long long, unsigned long long>,
+		std::weak_ptr<MappedFile> > mappedFiles;
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& fileName) {
+  struct stat st;
+  std::shared_ptr<MappedFile> file, old;
+  void *dataA;
+  long long tail;
+  int fd;
+
+  if ((fd = ::open(fileName.c_str(), O_RDONLY)) < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+    ::close(fd);
+    return NULL;
+  }
+
+  // reuse an existing mapping if the file hasn't changed since (<old>
+  // is declared before the lock so that, if it turns out to be the last
+  // reference, the mapping is released after the lock)
+  std::lock_guard<std::mutex> lock(mappedFilesMutex);
+  auto key = std::make_pair((unsigned long long)st.st_dev,
+			    (unsigned long long)st.st_ino);
+  auto it = mappedFiles.find(key);
+  if (it != mappedFiles.end()) {
+    old = it->second.lock();
+    if (old && old->length == (long long)st.st_size &&
+	old->mtime == (long long)st.st_mtime) {
+      ::close(fd);
+      return old;
+    }
+    mappedFiles.erase(it);
+  }
+
+  dataA = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (dataA == MAP_FAILED) {
+    return NULL;
+  }
+  file.reset(new MappedFile(fileName, (char *)dataA, (long long)st.st_size,
+			    (unsigned long long)st.st_dev,
+			    (unsigned long long)st.st_ino,
+			    (long long)st.st_mtime));
+  mappedFiles[key] = file;
+
+  // start reading the trailer and xref table in the background
+  tail = file->length < mappedFileTailSize ? 0
+                                           : file->length - mappedFileTailSize;
+  tail &= ~((long long)sysconf(_SC_PAGESIZE) - 1);
+  madvise(file->data + tail, (size_t)(file->length - tail), MADV_WILLNEED);
+
+  return file;
+}
+
+MappedFile::MappedFile(const std::string& fileNameA, char *dataA,
+		       long long lengthA, unsigned long long devA,
+		       unsigned long long inoA, long long mtimeA) {
+  fileName = fileNameA;
+  data = dataA;
+  length = lengthA;
+  dev = devA;
+  ino = inoA;
+  mtime = mtimeA;
+}
+
+MappedFile::~MappedFile() {
+  munmap(data, (size_t)length);
+
+  // the map entry (if it's still ours) is now a dangling weak_ptr
+  std::lock_guard<std::mutex> lock(mappedFilesMutex);
+  auto it = mappedFiles.find(std::make_pair(dev, ino));
+  if (it != mappedFiles.end() && it->second.expired()) {
+    mappedFiles.erase(it);
+  }
+}
+
+void MappedFile::adviseSequential() {
+  madvise(data, (size_t)length, MADV_SEQUENTIAL);
+}
+
+void MappedFile::adviseRandom() {
+  madvise(data, (size_t)length, MADV_RANDOM);
+}
+
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+#ifndef OBJECT_NO_FREE
+static Object *nullDict() {
+  static Object obj;
+
+  obj.initNull();
+  return &obj;
+}
+#endif
+
+MappedFileStream::MappedFileStream(std::shared_ptr<MappedFile> fileA):
+#ifdef OBJECT_NO_FREE
+  MemStream((char *)fileA->getData(), 0, fileA->getLength(),
+	    Object(objNull))
+#else
+  MemStream((char *)fileA->getData(), 0, fileA->getLength(), nullDict())
+#endif
+{
+  file = fileA;
+  fileNameGS.reset(makeGooString(file->getFileName()));
+}
+
+MappedFileStream::~MappedFileStream() {
+}
+
+BaseStream *MappedFileStream::copy() {
+  return new MappedFileStream(file);
+}
+
+GooString *MappedFileStream::getFileName() {
+  return fileNameGS.get();
+}
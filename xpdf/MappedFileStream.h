@@ -0,0 +1,91 @@
+//========================================================================
+//
+// MappedFileStream.h
+//
+// A PDF input stream that reads a memory-mapped file.
+//
+//========================================================================
+
+#ifndef MAPPEDFILESTREAM_H
+#define MAPPEDFILESTREAM_H
+
+#include <poppler-config.h>
+
+#include <memory>
+#include <string>
+#include "Stream.h"
+#include "config.h"
+
+class GooString;
+
+//------------------------------------------------------------------------
+// MappedFile
+//------------------------------------------------------------------------
+
+// A read-only mapping of a whole file.  The kernel pages the file in
+// as it is touched, and the pages come straight from the page cache,
+// so nothing is copied and the memory is shared with anything else
+// that has the file open.  Mappings are shared: opening a file that is
+// already mapped (and hasn't changed since) returns the same object.
+class MappedFile {
+public:
+
+  // Map a file.  Returns NULL if the file can't be mapped (e.g., it
+  // isn't a regular file, or it's empty).
+  static std::shared_ptr<MappedFile> open(const std::string& fileName);
+
+  ~MappedFile();
+
+  const char *getData() { return data; }
+  long long getLength() { return length; }
+  const std::string& getFileName() { return fileName; }
+
+  // Tell the kernel that the file is about to be read from start to
+  // end (e.g., while the xref table is read or reconstructed), so it
+  // reads ahead aggressively.
+  void adviseSequential();
+
+  // Tell the kernel that the file is being read in no particular order
+  // (e.g., object lookups while pages are displayed), so it doesn't
+  // read ahead more than is needed.
+  void adviseRandom();
+
+private:
+
+  MappedFile(const std::string& fileNameA, char *dataA, long long lengthA,
+	     unsigned long long devA, unsigned long long inoA,
+	     long long mtimeA);
+
+  std::string fileName;
+  char *data;
+  long long length;
+  unsigned long long dev, ino;	// identify the file for sharing
+  long long mtime;
+};
+
+//------------------------------------------------------------------------
+// MappedFileStream
+//------------------------------------------------------------------------
+
+// A MemStream over a MappedFile, which keeps the mapping alive for as
+// long as the stream (or any copy of it) exists.  PDFDoc takes the
+// file name from the stream, so a document opened this way still has
+// one.
+class MappedFileStream: public MemStream {
+public:
+
+  MappedFileStream(std::shared_ptr<MappedFile> fileA);
+  ~MappedFileStream();
+
+  BaseStream *copy() override;
+  GooString *getFileName() override;
+
+  std::shared_ptr<MappedFile> getMappedFile() { return file; }
+
+private:
+
+  std::shared_ptr<MappedFile> file;
+  std::unique_ptr<GooString> fileNameGS;
+};
+
+#endif
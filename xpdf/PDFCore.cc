@@ -10,22 +10,23 @@
 
 #include <poppler-config.h>
 
+#include <algorithm>
 #include <math.h>
 #include <memory>
 #include <stdlib.h>
 #include <goo/GooString.h>
 #include "GlobalParams.h"
 #include "XPDFParams.h"
-#include <splash/Splash.h>
 #include <splash/SplashBitmap.h>
-#include <splash/SplashPattern.h>
-#include <splash/SplashPath.h>
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "PDFDoc.h"
 #include "Link.h"
 #include "TextOutputDev.h"
 #include "CoreOutputDev.h"
+#include "DiskTileCache.h"
+#include "MappedFileStream.h"
+#include "TileRenderPool.h"
 #include "PDFCore.h"
 #include "config.h"
 
@@ -35,14 +36,24 @@
 
 PDFCorePage::PDFCorePage(int pageA, int wA, int hA, int tileWA, int tileHA) {
   page = pageA;
+  xDest = yDest = 0;
+  placed = false;
   w = wA;
   h = hA;
   tileW = tileWA;
   tileH = tileHA;
-  text = NULL;
 }
 
-PDFCorePage::~PDFCorePage() {
+//------------------------------------------------------------------------
+// PDFCoreText
+//------------------------------------------------------------------------
+
+PDFCoreText::PDFCoreText(int pageA, TextPage *textA) {
+  page = pageA;
+  text = textA;
+}
+
+PDFCoreText::~PDFCoreText() {
   if (text) {
     text->decRefCnt(); // this will delete text itself
   }
@@ -53,6 +64,7 @@ PDFCorePage::~PDFCorePage() {
 //------------------------------------------------------------------------
 
 PDFCoreTile::PDFCoreTile(int xDestA, int yDestA) {
+  page = 0;
   xMin = 0;
   yMin = 0;
   xMax = 0;
@@ -60,6 +72,7 @@ PDFCoreTile::PDFCoreTile(int xDestA, int yDestA) {
   xDest = xDestA;
   yDest = yDestA;
   bitmap = NULL;
+  renderID = 0;
 }
 
 PDFCoreTile::~PDFCoreTile() {
@@ -68,6 +81,25 @@ PDFCoreTile::~PDFCoreTile() {
   }
 }
 
+//------------------------------------------------------------------------
+// PDFCoreCachedTile
+//------------------------------------------------------------------------
+
+PDFCoreCachedTile::PDFCoreCachedTile() {
+  page = 0;
+  dpi = 0;
+  rotate = 0;
+  xMin = yMin = xMax = yMax = 0;
+  bitmap = NULL;
+  renderID = 0;
+}
+
+PDFCoreCachedTile::~PDFCoreCachedTile() {
+  if (bitmap) {
+    delete bitmap;
+  }
+}
+
 
 //------------------------------------------------------------------------
 // PDFCore
@@ -75,7 +107,10 @@ PDFCoreTile::~PDFCoreTile() {
 
 PDFCore::PDFCore(SplashColorMode colorModeA, int bitmapRowPadA,
 		 bool reverseVideoA, SplashColorPtr paperColorA) {
+  long long bandThreshold;
+
   continuousMode = xpdfParams->getContinuousView();
+  tileSize = xpdfParams->getTileSize();
   drawAreaWidth = drawAreaHeight = 0;
   maxPageW = totalDocH = 0;
   topPage = 0;
@@ -99,11 +134,25 @@ PDFCore::PDFCore(SplashColorMode colorModeA, int bitmapRowPadA,
 
   curTile = NULL;
 
+  colorMode = colorModeA;
+  bitmapRowPad = bitmapRowPadA;
   splashColorCopy(paperColor, paperColorA);
+  reverseVideo = reverseVideoA;
   out = std::make_unique<CoreOutputDev>(colorModeA, bitmapRowPadA,
 					reverseVideoA, paperColorA,
 					&redrawCbk, this);
   out->startDoc(NULL);
+  diskCache = std::make_unique<DiskTileCache>(colorModeA, bitmapRowPadA,
+			       paperColorA,
+			       (long long)xpdfParams->getDiskCacheSize() << 20);
+  bandThreshold = (long long)(xpdfParams->getRenderBandThreshold() * 1e6);
+  renderPool = std::make_unique<TileRenderPool>(colorModeA, bitmapRowPadA,
+						paperColorA,
+						xpdfParams->getRenderThreads(),
+						bandThreshold,
+						diskCache.get());
+  lastRenderID = 0;
+  scrollDir = 1;
 }
 
 int PDFCore::loadFile(const std::string& fileName,
@@ -111,13 +160,31 @@ int PDFCore::loadFile(const std::string& fileName,
 		      const std::string *userPassword) {
   int err;
   std::unique_ptr<std::string> promptPassword;
+  std::shared_ptr<MappedFile> mappedFile;
+  PDFDoc *newDoc;
+
+  if (xpdfParams->getMapFiles()) {
+    mappedFile = MappedFile::open(fileName);
+  }
 
   for (int i = 0; i < 3; ++i) {
     setBusyCursor(true);
     auto ownerGS = makeGooStringPtr(ownerPassword);
     auto userGS = makeGooStringPtr(ownerPassword);
-    err = loadFile2(new PDFDoc(makeGooString(fileName),
-			       ownerGS.get(), userGS.get(), this));
+    if (mappedFile) {
+      // the xref table is read (or reconstructed) front to back; after
+      // that, objects are looked up in whatever order pages need them
+      mappedFile->adviseSequential();
+      newDoc = new PDFDoc(new MappedFileStream(mappedFile),
+			  ownerGS.get(), userGS.get(), this);
+    } else {
+      newDoc = new PDFDoc(makeGooString(fileName),
+			  ownerGS.get(), userGS.get(), this);
+    }
+    err = loadFile2(newDoc, ownerPassword, userPassword);
+    if (mappedFile) {
+      mappedFile->adviseRandom();
+    }
     setBusyCursor(false);
 
     if (err != errEncrypted) {
@@ -153,10 +220,10 @@ void PDFCore::loadDoc(PDFDoc *docA) {
   setBusyCursor(false);
 }
 
-int PDFCore::loadFile2(PDFDoc *newDoc) {
+int PDFCore::loadFile2(PDFDoc *newDoc, const std::string *ownerPassword,
+		       const std::string *userPassword) {
+  MappedFileStream *mappedStr;
   int err;
-  double w, h, t;
-  int i;
 
   // open the PDF file
   if (!newDoc->isOk()) {
@@ -177,29 +244,160 @@ int PDFCore::loadFile2(PDFDoc *newDoc) {
   if (out) {
     out->startDoc(newDoc);
   }
+  if (doc->getFileName()) {
+    mappedStr = dynamic_cast<MappedFileStream *>(doc->getBaseStream());
+    renderPool->setDoc(toString(doc->getFileName()),
+		       ownerPassword, userPassword,
+		       mappedStr ? mappedStr->getMappedFile() : NULL);
+    diskCache->setDoc(toString(doc->getFileName()));
+  } else {
+    renderPool->clearDoc();
+    diskCache->clearDoc();
+  }
+  tileCache.clear();
+  textPages.clear();
 
   // nothing displayed yet
   topPage = -99;
   midPage = -99;
   pages.clear();
 
-  // compute the max unscaled page size
+  initPageSizes();
+
+  return errNone;
+}
+
+// Set up the page size table for a new document.  Only page 1 is
+// looked at; the rest are filled in by learnPageSize() as they're
+// displayed, or in the background by scanPageSizes().
+void PDFCore::initPageSizes() {
+  PDFCorePageSize ps;
+
+  pageSizes.clear();
   maxUnscaledPageW = maxUnscaledPageH = 0;
+  fitPageW = fitPageH = 0;
+  pageSizeScanPos = 2;
+  pageLayoutStale = false;
+  if (doc->getNumPages() < 1) {
+    return;
+  }
+  ps.w = doc->getPageCropWidth(1);
+  ps.h = doc->getPageCropHeight(1);
+  ps.rotate = doc->getPageRotate(1);
+  ps.known = false;
+  pageSizes.assign(doc->getNumPages(), ps);
+  pageSizes[0].known = true;
+  getUnscaledPageSize(1, 0, &maxUnscaledPageW, &maxUnscaledPageH);
+  fitPageW = maxUnscaledPageW;
+  fitPageH = maxUnscaledPageH;
+}
+
+// Look up the real size of page <pg>, if that hasn't been done yet.
+void PDFCore::learnPageSize(int pg) {
+  PDFCorePageSize *ps;
+  double w, h;
+  int rot;
+
+  ps = &pageSizes[pg - 1];
+  if (ps->known) {
+    return;
+  }
+  ps->known = true;
+  w = doc->getPageCropWidth(pg);
+  h = doc->getPageCropHeight(pg);
+  rot = doc->getPageRotate(pg);
+  if (w != ps->w || h != ps->h || rot != ps->rotate) {
+    ps->w = w;
+    ps->h = h;
+    ps->rotate = rot;
+    pageLayoutStale = true;
+  }
+  getUnscaledPageSize(pg, 0, &w, &h);
+  if (w > maxUnscaledPageW) {
+    maxUnscaledPageW = w;
+    pageLayoutStale = true;
+  }
+  if (h > maxUnscaledPageH) {
+    maxUnscaledPageH = h;
+    pageLayoutStale = true;
+  }
+}
+
+// Get the unscaled size of page <pg> (which may be an estimate), as
+// displayed with rotation <rotateA>.
+void PDFCore::getUnscaledPageSize(int pg, int rotateA,
+				  double *w, double *h) {
+  PDFCorePageSize *ps;
+  int rot;
+
+  ps = &pageSizes[pg - 1];
+  rot = rotateA + ps->rotate;
+  if (rot >= 360) {
+    rot -= 360;
+  } else if (rot < 0) {
+    rot += 360;
+  }
+  if (rot == 90 || rot == 270) {
+    *w = ps->h;
+    *h = ps->w;
+  } else {
+    *w = ps->w;
+    *h = ps->h;
+  }
+}
+
+// Compute the continuous mode layout (pageY, maxPageW, totalDocH) at
+// the current resolution and rotation.
+void PDFCore::layoutPages() {
+  double uw, uh;
+  int w, h, i;
+
+  maxPageW = totalDocH = 0;
+  pageY.resize(doc->getNumPages());
   for (i = 1; i <= doc->getNumPages(); ++i) {
-    w = doc->getPageCropWidth(i);
-    h = doc->getPageCropHeight(i);
-    if (doc->getPageRotate(i) == 90 || doc->getPageRotate(i) == 270) {
-      t = w; w = h; h = t;
-    }
-    if (w > maxUnscaledPageW) {
-      maxUnscaledPageW = w;
+    pageY[i-1] = totalDocH;
+    getUnscaledPageSize(i, rotate, &uw, &uh);
+    w = (int)((uw * dpi) / 72 + 0.5);
+    h = (int)((uh * dpi) / 72 + 0.5);
+    if (w > maxPageW) {
+      maxPageW = w;
     }
-    if (h > maxUnscaledPageH) {
-      maxUnscaledPageH = h;
+    totalDocH += h;
+    if (i < doc->getNumPages()) {
+      totalDocH += continuousModePageSpacing;
     }
   }
+  pageLayoutStale = false;
+}
 
-  return errNone;
+// Look up the sizes of the next few pages that haven't been displayed
+// yet, and redo the layout if any of them turn out to be different
+// from the estimates.  This is meant to be called repeatedly while the
+// program is idle; it returns true once all of the pages are done.
+bool PDFCore::scanPageSizes() {
+  int i, dy;
+
+  if (!doc) {
+    return true;
+  }
+  for (i = 0;
+       i < pdfCorePageScanChunk && pageSizeScanPos <= doc->getNumPages();
+       ++i, ++pageSizeScanPos) {
+    learnPageSize(pageSizeScanPos);
+  }
+  if (pageLayoutStale && !pages.empty()) {
+    if (continuousMode) {
+      // keep the same part of the top page in view
+      dy = (int)(scrollY - pageY[topPage - 1]);
+      layoutPages();
+      update(topPage, scrollX, pageY[topPage - 1] + dy, zoom, rotate,
+	     false, false, false);
+    } else {
+      // only the continuous mode layout depends on other pages
+      pageLayoutStale = false;
+    }
+  }
+  return pageSizeScanPos > doc->getNumPages();
 }
 
 void PDFCore::clear() {
@@ -210,6 +408,10 @@ void PDFCore::clear() {
   // no document
   doc.reset();
   out->clear();
+  renderPool->clearDoc();
+  diskCache->clearDoc();
+  tileCache.clear();
+  textPages.clear();
 
   // no page displayed
   topPage = -99;
@@ -231,6 +433,10 @@ PDFDoc *PDFCore::takeDoc(bool redraw) {
 
   // no document
   docA = doc.release();
+  renderPool->clearDoc();
+  diskCache->clearDoc();
+  tileCache.clear();
+  textPages.clear();
 
   // no page displayed
   topPage = -99;
@@ -249,7 +455,8 @@ PDFDoc *PDFCore::takeDoc(bool redraw) {
 
 void PDFCore::displayPage(int topPageA, double zoomA, int rotateA,
 			  bool scrollToTop, bool addToHist) {
-  int scrollXA, scrollYA;
+  int scrollXA;
+  long long scrollYA;
 
   scrollXA = scrollX;
   if (continuousMode) {
@@ -275,7 +482,8 @@ void PDFCore::displayDest(PCONST LinkDest *dest, double zoomA, int rotateA,
 			  bool addToHist) {
   Ref pageRef;
   int topPageA;
-  int dx, dy, scrollXA, scrollYA;
+  int dx, dy, scrollXA;
+  long long scrollYA;
 
   if (dest->isPageRef()) {
     pageRef = dest->getPageRef();
@@ -369,15 +577,17 @@ void PDFCore::displayDest(PCONST LinkDest *dest, double zoomA, int rotateA,
   }
 }
 
-void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
+void PDFCore::update(int topPageA, int scrollXA, long long scrollYA,
 		     double zoomA, int rotateA, bool force,
 		     bool addToHist, bool adjustScrollX) {
-  double hDPI, vDPI, dpiA, uw, uh, ut;
-  int w, h, t, x0, x1, y0, y1, x, y;
-  int rot;
+  double dpiA;
+  int w, x0, x1, y0, y1, x, y, dx, dy;
+  long long docH, ty0, ty1, oldScrollY;
+  int rot, oldTopPage, pg0, pg1;
   PDFHistory *hist;
-  bool needUpdate;
-  int i, j;
+  std::vector<PDFCorePage *> newPages;
+  bool needUpdate, visible, shifted, gotShift;
+  int pass, i, j;
 
   // check for document and valid page number
   if (!doc) {
@@ -404,47 +614,18 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     }
   }
 
-  // compute the DPI
-  if (continuousMode) {
-    uw = maxUnscaledPageW;
-    uh = maxUnscaledPageH;
-    rot = rotateA;
-  } else {
-    uw = doc->getPageCropWidth(topPageA);
-    uh = doc->getPageCropHeight(topPageA);
-    rot = rotateA + doc->getPageRotate(topPageA);
-    if (rot >= 360) {
-      rot -= 360;
-    } else if (rot < 0) {
-      rot += 360;
-    }
-  }
-  if (rot == 90 || rot == 270) {
-    ut = uw; uw = uh; uh = ut;
-  }
-  if (zoomA == zoomPage) {
-    hDPI = (drawAreaWidth / uw) * 72;
-    if (continuousMode) {
-      vDPI = ((drawAreaHeight - continuousModePageSpacing) / uh) * 72;
-    } else {
-      vDPI = (drawAreaHeight / uh) * 72;
-    }
-    dpiA = (hDPI < vDPI) ? hDPI : vDPI;
-  } else if (zoomA == zoomWidth) {
-    dpiA = (drawAreaWidth / uw) * 72;
-  } else if (zoomA == zoomHeight) {
-    if (continuousMode) {
-      dpiA = ((drawAreaHeight - continuousModePageSpacing) / uh) * 72;
-    } else {
-      dpiA = (drawAreaHeight / uh) * 72;
-    }
-  } else {
-    dpiA = 0.01 * zoomA * 72;
-  }
-  // this can happen if the window hasn't been sized yet
-  if (dpiA <= 0) {
-    dpiA = 1;
+  oldTopPage = topPage;
+  oldScrollY = scrollY;
+
+  // compute the DPI -- page sizes learned since the last layout only
+  // affect the fit zooms when the user asks for a new layout, not when
+  // scrolling or scanning page sizes
+  if (force || pages.empty() || fabs(zoomA - zoom) > 1e-8 ||
+      rotateA != rotate) {
+    fitPageW = maxUnscaledPageW;
+    fitPageH = maxUnscaledPageH;
   }
+  dpiA = getPageDPI(topPageA, zoomA, rotateA);
 
   // if the display properties have changed, create a new PDFCorePage
   // object
@@ -454,34 +635,15 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
       rotateA != rotate) {
     needUpdate = true;
     setSelection(0, 0, 0, 0, 0);
+    for (auto& page: pages) {
+      cachePageTiles(page.get());
+    }
     pages.clear();
     zoom = zoomA;
     rotate = rotateA;
     dpi = dpiA;
     if (continuousMode) {
-      maxPageW = totalDocH = 0;
-      pageY.resize(doc->getNumPages());
-      for (i = 1; i <= doc->getNumPages(); ++i) {
-	pageY[i-1] = totalDocH;
-	w = (int)((doc->getPageCropWidth(i) * dpi) / 72 + 0.5);
-	h = (int)((doc->getPageCropHeight(i) * dpi) / 72 + 0.5);
-	rot = rotate + doc->getPageRotate(i);
-	if (rot >= 360) {
-	  rot -= 360;
-	} else if (rot < 0) {
-	  rot += 360;
-	}
-	if (rot == 90 || rot == 270) {
-	  t = w; w = h; h = t;
-	}
-	if (w > maxPageW) {
-	  maxPageW = w;
-	}
-	totalDocH += h;
-	if (i < doc->getNumPages()) {
-	  totalDocH += continuousModePageSpacing;
-	}
-      }
+      layoutPages();
     } else {
       rot = rotate + doc->getPageRotate(topPageA);
       if (rot >= 360) {
@@ -491,12 +653,6 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
       }
       addPage(topPageA, rot);
     }
-  } else {
-    // erase the selection
-    if (selectULX != selectLRX && selectULY != selectLRY) {
-      xorRectangle(selectPage, selectULX, selectULY, selectLRX, selectLRY,
-		   new SplashSolidColor(selectXorColor));
-    }
   }
   topPage = topPageA;
   midPage = topPage;
@@ -524,63 +680,60 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
       scrollX = (maxPageW - w) / 2;
     }
   }
-  if (continuousMode) {
-    w = maxPageW;
-    h = totalDocH;
-  } else {
-    const auto& page = pages.front();
-    w = page->w;
-    h = page->h;
-  }
-  if (scrollX > w - drawAreaWidth) {
-    scrollX = w - drawAreaWidth;
-  }
-  if (scrollX < 0) {
-    scrollX = 0;
-  }
-  if (scrollY > h - drawAreaHeight) {
-    scrollY = h - drawAreaHeight;
-  }
-  if (scrollY < 0) {
-    scrollY = 0;
-  }
-
-  // find topPage, and the first and last pages to be rasterized
-  if (continuousMode) {
-    int pg0, pg1;
-
-    //~ should use a binary search
-    for (i = 2; i <= doc->getNumPages(); ++i) {
-      if (pageY[i-1] > scrollY - drawAreaHeight / 2) {
-	break;
-      }
+  while (true) {
+    if (continuousMode) {
+      w = maxPageW;
+      docH = totalDocH;
+    } else {
+      const auto& page = pages.front();
+      w = page->w;
+      docH = page->h;
     }
-    pg0 = i - 1;
-    for (i = pg0 + 1; i <= doc->getNumPages(); ++i) {
-      if (pageY[i-1] > scrollY) {
-	break;
-      }
+    if (scrollX > w - drawAreaWidth) {
+      scrollX = w - drawAreaWidth;
     }
-    topPage = i - 1;
-    for (i = topPage + 1; i <= doc->getNumPages(); ++i) {
-      if (pageY[i-1] > scrollY + drawAreaHeight / 2) {
-	break;
-      }
+    if (scrollX < 0) {
+      scrollX = 0;
     }
-    midPage = i - 1;
-    for (i = midPage + 1; i <= doc->getNumPages(); ++i) {
-      if (pageY[i-1] > scrollY + drawAreaHeight + drawAreaHeight / 2) {
-	break;
-      }
+    if (scrollY > docH - drawAreaHeight) {
+      scrollY = docH - drawAreaHeight;
+    }
+    if (scrollY < 0) {
+      scrollY = 0;
+    }
+    if (!continuousMode) {
+      break;
+    }
+
+    // find topPage, and the first and last pages to be rasterized
+    pg0 = findPageAtY(scrollY - drawAreaHeight / 2);
+    topPage = findPageAtY(scrollY);
+    midPage = findPageAtY(scrollY + drawAreaHeight / 2);
+    pg1 = findPageAtY(scrollY + drawAreaHeight + drawAreaHeight / 2);
+
+    // look up the real sizes of those pages -- if any of them differ
+    // from the estimates, redo the layout (keeping the same part of
+    // the top page in view) and try again
+    for (i = pg0; i <= pg1; ++i) {
+      learnPageSize(i);
+    }
+    if (!pageLayoutStale) {
+      break;
     }
-    pg1 = i - 1;
+    dy = (int)(scrollY - pageY[topPage - 1]);
+    layoutPages();
+    scrollY = pageY[topPage - 1] + dy;
+  }
 
+  if (continuousMode) {
     // delete pages that are no longer needed and insert new pages
     // objects that are needed
     while (!pages.empty() && pages.front()->page < pg0) {
-      pages.erase(pages.begin());
+      cachePageTiles(pages.front().get());
+      pages.pop_front();
     }
     while (!pages.empty() && pages.back()->page > pg1) {
+      cachePageTiles(pages.back().get());
       pages.pop_back();
     }
     j = pages.empty() ? pg1 : pages.front()->page - 1;
@@ -605,36 +758,56 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     }
   }
 
+  // keep track of which way the user is moving through the document,
+  // for prefetching
+  if (continuousMode) {
+    if (scrollY > oldScrollY) {
+      scrollDir = 1;
+    } else if (scrollY < oldScrollY) {
+      scrollDir = -1;
+    }
+  } else if (oldTopPage > 0 && topPage != oldTopPage) {
+    scrollDir = topPage > oldTopPage ? 1 : -1;
+  }
+
   // delete tiles that are no longer needed
   for (auto& page: pages) {
     auto it = page->tiles.begin();
     while (it < page->tiles.end()) {
       auto& tile = *it;
       if (continuousMode) {
-	y0 = pageY[page->page - 1] + tile->yMin;
-	y1 = pageY[page->page - 1] + tile->yMax;
+	ty0 = pageY[page->page - 1] + tile->yMin;
+	ty1 = pageY[page->page - 1] + tile->yMax;
       } else {
-	y0 = tile->yMin;
-	y1 = tile->yMax;
+	ty0 = tile->yMin;
+	ty1 = tile->yMax;
       }
       if (tile->xMax < scrollX - drawAreaWidth / 2 ||
 	  tile->xMin > scrollX + drawAreaWidth + drawAreaWidth / 2 ||
-	  y1 < scrollY - drawAreaHeight / 2 ||
-	  y0 > scrollY + drawAreaHeight + drawAreaHeight / 2) {
+	  ty1 < scrollY - drawAreaHeight / 2 ||
+	  ty0 > scrollY + drawAreaHeight + drawAreaHeight / 2) {
+	cacheTile(page.get(), tile.get());
 	it = page->tiles.erase(it);
       } else {
 	++it;
       }
     }
   }
+  trimTileCache();
 
-  // update page positions
+  // update page positions, and check whether everything that was
+  // already on screen has just moved by the same amount (<dx>, <dy>)
+  shifted = !needUpdate;
+  gotShift = false;
+  dx = dy = 0;
   for (auto& page: pages) {
+    x = page->xDest;
+    y = page->yDest;
     page->xDest = -scrollX;
     if (continuousMode) {
-      page->yDest = pageY[page->page - 1] - scrollY;
+      page->yDest = (int)(pageY[page->page - 1] - scrollY);
     } else {
-      page->yDest = -scrollY;
+      page->yDest = (int)-scrollY;
     }
     if (continuousMode) {
       if (page->w < maxPageW) {
@@ -647,37 +820,74 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
       page->xDest += (drawAreaWidth - page->w) / 2;
     }
     if (continuousMode && totalDocH < drawAreaHeight) {
-      page->yDest += (drawAreaHeight - totalDocH) / 2;
+      page->yDest += (int)(drawAreaHeight - totalDocH) / 2;
     } else if (!continuousMode && page->h < drawAreaHeight) {
       page->yDest += (drawAreaHeight - page->h) / 2;
     }
+    if (!page->placed) {
+      newPages.push_back(page.get());
+      page->placed = true;
+    } else if (!gotShift) {
+      dx = page->xDest - x;
+      dy = page->yDest - y;
+      gotShift = true;
+    } else if (page->xDest - x != dx || page->yDest - y != dy) {
+      shifted = false;
+    }
+  }
+  if (!gotShift || abs(dx) >= drawAreaWidth || abs(dy) >= drawAreaHeight) {
+    shifted = false;
+  }
+
+  // new pages must be entirely in the area uncovered by the shift
+  if (shifted) {
+    x0 = dx > 0 ? dx : 0;
+    x1 = dx < 0 ? drawAreaWidth + dx : drawAreaWidth;
+    y0 = dy > 0 ? dy : 0;
+    y1 = dy < 0 ? drawAreaHeight + dy : drawAreaHeight;
+    for (PDFCorePage *page: newPages) {
+      if (page->xDest < x1 && page->xDest + page->w > x0 &&
+	  page->yDest < y1 && page->yDest + page->h > y0) {
+	shifted = false;
+      }
+    }
   }
 
-  // rasterize any new tiles
-  for (auto& page: pages) {
-    x0 = page->xDest;
-    x1 = x0 + page->w - 1;
-    if (x0 < -drawAreaWidth / 2) {
-      x0 = -drawAreaWidth / 2;
-    }
-    if (x1 > drawAreaWidth + drawAreaWidth / 2) {
-      x1 = drawAreaWidth + drawAreaWidth / 2;
-    }
-    x0 = ((x0 - page->xDest) / page->tileW) * page->tileW;
-    x1 = ((x1 - page->xDest) / page->tileW) * page->tileW;
-    y0 = page->yDest;
-    y1 = y0 + page->h - 1;
-    if (y0 < -drawAreaHeight / 2) {
-      y0 = -drawAreaHeight / 2;
-    }
-    if (y1 > drawAreaHeight + drawAreaHeight / 2) {
-      y1 = drawAreaHeight + drawAreaHeight / 2;
-    }
-    y0 = ((y0 - page->yDest) / page->tileH) * page->tileH;
-    y1 = ((y1 - page->yDest) / page->tileH) * page->tileH;
-    for (y = y0; y <= y1; y += page->tileH) {
-      for (x = x0; x <= x1; x += page->tileW) {
-	needTile(page.get(), x, y);
+  // rasterize any new tiles -- the ones in the window first, then
+  // the ones in the margin around it, so the render pool works on
+  // what the user can see before anything else
+  for (pass = 0; pass < 2; ++pass) {
+    for (auto& page: pages) {
+      x0 = page->xDest;
+      x1 = x0 + page->w - 1;
+      if (x0 < -drawAreaWidth / 2) {
+	x0 = -drawAreaWidth / 2;
+      }
+      if (x1 > drawAreaWidth + drawAreaWidth / 2) {
+	x1 = drawAreaWidth + drawAreaWidth / 2;
+      }
+      x0 = ((x0 - page->xDest) / page->tileW) * page->tileW;
+      x1 = ((x1 - page->xDest) / page->tileW) * page->tileW;
+      y0 = page->yDest;
+      y1 = y0 + page->h - 1;
+      if (y0 < -drawAreaHeight / 2) {
+	y0 = -drawAreaHeight / 2;
+      }
+      if (y1 > drawAreaHeight + drawAreaHeight / 2) {
+	y1 = drawAreaHeight + drawAreaHeight / 2;
+      }
+      y0 = ((y0 - page->yDest) / page->tileH) * page->tileH;
+      y1 = ((y1 - page->yDest) / page->tileH) * page->tileH;
+      for (y = y0; y <= y1; y += page->tileH) {
+	for (x = x0; x <= x1; x += page->tileW) {
+	  visible = page->xDest + x < drawAreaWidth &&
+		    page->xDest + x + page->tileW > 0 &&
+		    page->yDest + y < drawAreaHeight &&
+		    page->yDest + y + page->tileH > 0;
+	  if (visible == (pass == 0)) {
+	    needTile(page.get(), x, y);
+	  }
+	}
       }
     }
   }
@@ -687,9 +897,9 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
     for (auto& tile: page->tiles) {
       tile->xDest = tile->xMin - scrollX;
       if (continuousMode) {
-	tile->yDest = tile->yMin + pageY[page->page - 1] - scrollY;
+	tile->yDest = tile->yMin + (int)(pageY[page->page - 1] - scrollY);
       } else {
-	tile->yDest = tile->yMin - scrollY;
+	tile->yDest = (int)(tile->yMin - scrollY);
       }
       if (continuousMode) {
 	if (page->w < maxPageW) {
@@ -702,23 +912,38 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
 	tile->xDest += (drawAreaWidth - page->w) / 2;
       }
       if (continuousMode && totalDocH < drawAreaHeight) {
-	tile->yDest += (drawAreaHeight - totalDocH) / 2;
+	tile->yDest += (int)(drawAreaHeight - totalDocH) / 2;
       } else if (!continuousMode && page->h < drawAreaHeight) {
 	tile->yDest += (drawAreaHeight - page->h) / 2;
       }
     }
   }
+  updateBusyCursor();
 
-  // redraw the selection
-  if (selectULX != selectLRX && selectULY != selectLRY) {
-    xorRectangle(selectPage, selectULX, selectULY, selectLRX, selectLRY,
-		 new SplashSolidColor(selectXorColor));
+  // redraw the window -- if it has only been scrolled, move what's
+  // already there, and draw just the strips that were uncovered (this
+  // isn't safe if a tile was rendered in the foreground above, since
+  // that draws it straight into the window)
+  if (shifted && (dx || dy) && renderPool->canRender() &&
+      scrollWindow(dx, dy)) {
+    if (dy > 0) {
+      redrawWindow(0, 0, drawAreaWidth, dy, false);
+    } else if (dy < 0) {
+      redrawWindow(0, drawAreaHeight + dy, drawAreaWidth, -dy, false);
+    }
+    if (dx > 0) {
+      redrawWindow(0, 0, dx, drawAreaHeight, false);
+    } else if (dx < 0) {
+      redrawWindow(drawAreaWidth + dx, 0, -dx, drawAreaHeight, false);
+    }
+  } else {
+    redrawWindow(0, 0, drawAreaWidth, drawAreaHeight, needUpdate);
   }
-
-  // redraw the window
-  redrawWindow(0, 0, drawAreaWidth, drawAreaHeight, needUpdate);
   updateScrollbars();
 
+  // start rendering what the user is likely to look at next
+  prefetch();
+
   // add to history
   if (addToHist) {
     if (++historyCur == pdfHistorySize) {
@@ -750,30 +975,85 @@ void PDFCore::update(int topPageA, int scrollXA, int scrollYA,
   }
 }
 
-void PDFCore::addPage(int pg, int rot) {
-  int w, h, t, tileW, tileH;
+// Compute the resolution at which page <pg> would be displayed.
+double PDFCore::getPageDPI(int pg, double zoomA, int rotateA) {
+  double hDPI, vDPI, dpiA, uw, uh, ut;
+  int rot;
 
-  w = (int)((doc->getPageCropWidth(pg) * dpi) / 72 + 0.5);
-  h = (int)((doc->getPageCropHeight(pg) * dpi) / 72 + 0.5);
+  if (continuousMode) {
+    uw = fitPageW;
+    uh = fitPageH;
+    rot = rotateA;
+    if (rot == 90 || rot == 270) {
+      ut = uw; uw = uh; uh = ut;
+    }
+  } else {
+    learnPageSize(pg);
+    getUnscaledPageSize(pg, rotateA, &uw, &uh);
+  }
+  if (zoomA == zoomPage) {
+    hDPI = (drawAreaWidth / uw) * 72;
+    if (continuousMode) {
+      vDPI = ((drawAreaHeight - continuousModePageSpacing) / uh) * 72;
+    } else {
+      vDPI = (drawAreaHeight / uh) * 72;
+    }
+    dpiA = (hDPI < vDPI) ? hDPI : vDPI;
+  } else if (zoomA == zoomWidth) {
+    dpiA = (drawAreaWidth / uw) * 72;
+  } else if (zoomA == zoomHeight) {
+    if (continuousMode) {
+      dpiA = ((drawAreaHeight - continuousModePageSpacing) / uh) * 72;
+    } else {
+      dpiA = (drawAreaHeight / uh) * 72;
+    }
+  } else {
+    dpiA = 0.01 * zoomA * 72;
+  }
+  // this can happen if the window hasn't been sized yet
+  if (dpiA <= 0) {
+    dpiA = 1;
+  }
+  return dpiA;
+}
+
+// Compute the size of page <pg> at <dpiA>, and the tile size for it.
+void PDFCore::getPageSize(int pg, double dpiA, int rot, int *w, int *h,
+			  int *tileW, int *tileH) {
+  int t;
+
+  learnPageSize(pg);
+  *w = (int)((pageSizes[pg - 1].w * dpiA) / 72 + 0.5);
+  *h = (int)((pageSizes[pg - 1].h * dpiA) / 72 + 0.5);
   if (rot == 90 || rot == 270) {
-    t = w; w = h; h = t;
+    t = *w; *w = *h; *h = t;
   }
-  tileW = 2 * drawAreaWidth;
-  if (tileW < 1500) {
-    tileW = 1500;
+  if (tileSize > 0) {
+    *tileW = *tileH = tileSize;
+  } else {
+    *tileW = 2 * drawAreaWidth;
+    if (*tileW < 1500) {
+      *tileW = 1500;
+    }
+    *tileH = 2 * drawAreaHeight;
+    if (*tileH < 1500) {
+      *tileH = 1500;
+    }
   }
-  if (tileW > w) {
+  if (*tileW > *w) {
     // tileW can't be zero -- we end up with div-by-zero problems
-    tileW = w ? w : 1;
-  }
-  tileH = 2 * drawAreaHeight;
-  if (tileH < 1500) {
-    tileH = 1500;
+    *tileW = *w ? *w : 1;
   }
-  if (tileH > h) {
+  if (*tileH > *h) {
     // tileH can't be zero -- we end up with div-by-zero problems
-    tileH = h ? h : 1;
+    *tileH = *h ? *h : 1;
   }
+}
+
+void PDFCore::addPage(int pg, int rot) {
+  int w, h, tileW, tileH;
+
+  getPageSize(pg, dpi, rot, &w, &h, &tileW, &tileH);
   auto it = pages.begin();
   while (it < pages.end() && pg > (*it)->page) {
     ++it;
@@ -783,8 +1063,9 @@ void PDFCore::addPage(int pg, int rot) {
 
 void PDFCore::needTile(PDFCorePage *page, int x, int y) {
   PDFCoreTile *tile;
-  TextOutputDev *textOut;
-  int xDest, yDest, sliceW, sliceH;
+  std::unique_ptr<PDFCoreCachedTile> cached;
+  std::string tileFile;
+  int xDest, yDest, sliceW, sliceH, w, h;
 
   for (auto& oldTile: page->tiles) {
     if (x == oldTile->xMin && y == oldTile->yMin) {
@@ -792,97 +1073,683 @@ void PDFCore::needTile(PDFCorePage *page, int x, int y) {
     }
   }
 
-  setBusyCursor(true);
-
-  sliceW = page->tileW;
-  if (x + sliceW > page->w) {
-    sliceW = page->w - x;
-  }
-  sliceH = page->tileH;
-  if (y + sliceH > page->h) {
-    sliceH = page->h - y;
+  sliceW = page->tileW;
+  if (x + sliceW > page->w) {
+    sliceW = page->w - x;
+  }
+  sliceH = page->tileH;
+  if (y + sliceH > page->h) {
+    sliceH = page->h - y;
+  }
+
+  xDest = x - scrollX;
+  if (continuousMode) {
+    yDest = y + (int)(pageY[page->page - 1] - scrollY);
+  } else {
+    yDest = (int)(y - scrollY);
+  }
+  if (continuousMode) {
+    if (page->w < maxPageW) {
+      xDest += (maxPageW - page->w) / 2;
+    }
+    if (maxPageW < drawAreaWidth) {
+      xDest += (drawAreaWidth - maxPageW) / 2;
+    }
+  } else if (page->w < drawAreaWidth) {
+    xDest += (drawAreaWidth - page->w) / 2;
+  }
+  if (continuousMode && totalDocH < drawAreaHeight) {
+    yDest += (int)(drawAreaHeight - totalDocH) / 2;
+  } else if (!continuousMode && page->h < drawAreaHeight) {
+    yDest += (drawAreaHeight - page->h) / 2;
+  }
+  tile = newTile(xDest, yDest);
+  tile->page = page->page;
+  tile->xMin = x;
+  tile->yMin = y;
+  tile->xMax = x + sliceW;
+  tile->yMax = y + sliceH;
+  tile->edges = 0;
+  if (tile->xMin == 0) {
+    tile->edges |= pdfCoreTileLeftEdge;
+  }
+  if (tile->xMax == page->w) {
+    tile->edges |= pdfCoreTileRightEdge;
+  }
+  if (continuousMode) {
+    if (tile->yMin == 0) {
+      tile->edges |= pdfCoreTileTopSpace;
+      if (page->page == 1) {
+	tile->edges |= pdfCoreTileTopEdge;
+      }
+    }
+    if (tile->yMax == page->h) {
+      tile->edges |= pdfCoreTileBottomSpace;
+      if (page->page == doc->getNumPages()) {
+	tile->edges |= pdfCoreTileBottomEdge;
+      }
+    }
+  } else {
+    if (tile->yMin == 0) {
+      tile->edges |= pdfCoreTileTopEdge;
+    }
+    if (tile->yMax == page->h) {
+      tile->edges |= pdfCoreTileBottomEdge;
+    }
+  }
+  cached = takeCachedTile(page->page, dpi, tile->xMin, tile->yMin,
+			  tile->xMax, tile->yMax);
+  if (!cached) {
+    tileFile = diskCache->getTileFile(page->page, dpi, rotate, x, y,
+				      sliceW, sliceH, reverseVideo);
+  }
+  if (cached && cached->bitmap) {
+    // the prefetcher has already rendered this slice
+    tile->bitmap = cached->bitmap;
+    cached->bitmap = NULL;
+    memcpy(tile->ctm, cached->ctm, 6 * sizeof(double));
+    memcpy(tile->ictm, cached->ictm, 6 * sizeof(double));
+  } else if (!cached && (tile->bitmap = diskCache->load(tileFile))) {
+    // this slice was rendered in an earlier session
+    setTileCTM(page, tile);
+  }
+  if (tile->bitmap) {
+    w = tile->bitmap->getWidth();
+    if (w > sliceW) {
+      w = sliceW;
+    }
+    h = tile->bitmap->getHeight();
+    if (h > sliceH) {
+      h = sliceH;
+    }
+    updateTileData(tile, 0, 0, w, h, true);
+  } else if (cached) {
+    // the prefetcher has queued this slice -- move it to the front
+    tile->renderID = cached->renderID;
+    renderPool->promote(tile->renderID);
+    setTileCTM(page, tile);
+    showPreview(page, tile);
+  } else if (renderPool->canRender()) {
+    // hand the slice off to the render pool -- finishTiles() will pick
+    // up the bitmap when it's done
+    auto job = std::make_unique<TileRenderJob>();
+    job->id = tile->renderID = ++lastRenderID;
+    job->page = page->page;
+    job->dpi = dpi;
+    job->rotate = rotate;
+    job->x = x;
+    job->y = y;
+    job->w = sliceW;
+    job->h = sliceH;
+    job->reverseVideo = reverseVideo;
+    job->tileFile = tileFile;
+    setTileCTM(page, tile);
+    renderPool->submit(std::move(job));
+    showPreview(page, tile);
+  } else {
+    setBusyCursor(true);
+    renderTile(page, tile);
+  }
+  if (!page->links) {
+    page->links.reset(doc->getLinks(page->page));
+  }
+  page->tiles.emplace_back(tile);
+
+  if (!tile->renderID && tile->bitmap) {
+    releaseTileBitmap(tile);
+  }
+}
+
+// Rasterize a tile in the foreground.
+void PDFCore::renderTile(PDFCorePage *page, PDFCoreTile *tile) {
+  if (tile->bitmap) {
+    // discard the preview
+    delete tile->bitmap;
+    tile->bitmap = NULL;
+  }
+  curTile = tile;
+  curPage = page;
+  doc->displayPageSlice(out.get(), page->page, dpi, dpi, rotate,
+			false, true, false, tile->xMin, tile->yMin,
+			tile->xMax - tile->xMin, tile->yMax - tile->yMin);
+  tile->bitmap = out->takeBitmap();
+  memcpy(tile->ctm, out->getDefCTM(), 6 * sizeof(double));
+  memcpy(tile->ictm, out->getDefICTM(), 6 * sizeof(double));
+  diskCache->store(diskCache->getTileFile(page->page, dpi, rotate,
+					  tile->xMin, tile->yMin,
+					  tile->xMax - tile->xMin,
+					  tile->yMax - tile->yMin,
+					  reverseVideo),
+		   tile->bitmap);
+  curTile = NULL;
+  curPage = NULL;
+}
+
+// While a tile is being rendered, fill it in with a rescaled copy of
+// whatever cached tiles of the same page there are at other
+// resolutions (e.g., the tiles from before a zoom change).  The
+// preview is replaced by finishTiles() when the real bitmap arrives.
+void PDFCore::showPreview(PDFCorePage *page, PDFCoreTile *tile) {
+  std::vector<PDFCoreCachedTile *> srcs;
+  std::vector<int> srcX;
+  SplashBitmap *bitmap;
+  SplashColor paper;
+  SplashColorPtr p, q, srcRow;
+  double scale;
+  int nComps, w, h, dx0, dx1, dy0, dy1, sx, sy, x, y, i;
+
+  // get the paper color in the bitmap's byte order
+  switch (colorMode) {
+  case splashModeMono8:
+    nComps = 1;
+    paper[0] = paperColor[0];
+    break;
+  case splashModeRGB8:
+    nComps = 3;
+    paper[0] = paperColor[0];
+    paper[1] = paperColor[1];
+    paper[2] = paperColor[2];
+    break;
+  case splashModeBGR8:
+  case splashModeXBGR8:
+    nComps = colorMode == splashModeBGR8 ? 3 : 4;
+    paper[0] = paperColor[2];
+    paper[1] = paperColor[1];
+    paper[2] = paperColor[0];
+    paper[3] = 255;
+    break;
+  default:
+    return;
+  }
+
+  // find cached tiles that overlap this one
+  for (auto& cached: tileCache) {
+    if (cached->page != page->page || cached->rotate != rotate ||
+	!cached->bitmap) {
+      continue;
+    }
+    scale = dpi / cached->dpi;
+    if (cached->xMax * scale <= tile->xMin ||
+	cached->xMin * scale >= tile->xMax ||
+	cached->yMax * scale <= tile->yMin ||
+	cached->yMin * scale >= tile->yMax) {
+      continue;
+    }
+    srcs.push_back(cached.get());
+  }
+  if (srcs.empty()) {
+    return;
+  }
+
+  // draw the closest resolutions last
+  std::sort(srcs.begin(), srcs.end(),
+	    [this](PDFCoreCachedTile *a, PDFCoreCachedTile *b) {
+	      return fabs(log(a->dpi / dpi)) > fabs(log(b->dpi / dpi));
+	    });
+
+  w = tile->xMax - tile->xMin;
+  h = tile->yMax - tile->yMin;
+  bitmap = new SplashBitmap(w, h, bitmapRowPad, colorMode, false);
+  for (y = 0; y < h; ++y) {
+    p = bitmap->getDataPtr() + y * bitmap->getRowSize();
+    for (x = 0; x < w; ++x) {
+      for (i = 0; i < nComps; ++i) {
+	*p++ = paper[i];
+      }
+    }
+  }
+
+  // nearest-neighbor scaling is plenty for something that will only
+  // be on screen for a moment
+  for (PDFCoreCachedTile *src: srcs) {
+    scale = dpi / src->dpi;
+    dx0 = (int)ceil(src->xMin * scale) - tile->xMin;
+    dx1 = (int)ceil(src->xMax * scale) - tile->xMin;
+    dy0 = (int)ceil(src->yMin * scale) - tile->yMin;
+    dy1 = (int)ceil(src->yMax * scale) - tile->yMin;
+    if (dx0 < 0) {
+      dx0 = 0;
+    }
+    if (dx1 > w) {
+      dx1 = w;
+    }
+    if (dy0 < 0) {
+      dy0 = 0;
+    }
+    if (dy1 > h) {
+      dy1 = h;
+    }
+    srcX.resize(w);
+    for (x = dx0; x < dx1; ++x) {
+      sx = (int)((tile->xMin + x + 0.5) / scale) - src->xMin;
+      if (sx < 0) {
+	sx = 0;
+      } else if (sx >= src->bitmap->getWidth()) {
+	sx = src->bitmap->getWidth() - 1;
+      }
+      srcX[x] = sx * nComps;
+    }
+    for (y = dy0; y < dy1; ++y) {
+      sy = (int)((tile->yMin + y + 0.5) / scale) - src->yMin;
+      if (sy < 0) {
+	sy = 0;
+      } else if (sy >= src->bitmap->getHeight()) {
+	sy = src->bitmap->getHeight() - 1;
+      }
+      srcRow = src->bitmap->getDataPtr() + sy * src->bitmap->getRowSize();
+      p = bitmap->getDataPtr() + y * bitmap->getRowSize() + dx0 * nComps;
+      for (x = dx0; x < dx1; ++x) {
+	q = srcRow + srcX[x];
+	for (i = 0; i < nComps; ++i) {
+	  *p++ = *q++;
+	}
+      }
+    }
+  }
+
+  tile->bitmap = bitmap;
+  updateTileData(tile, 0, 0, w, h, true);
+}
+
+// Set up a tile's CTM before it has been rendered, so the coordinate
+// conversion functions work while the render is pending.  This is the
+// page's default CTM, shifted to the tile's origin.
+void PDFCore::setTileCTM(PDFCorePage *page, PDFCoreTile *tile) {
+  doc->getCatalog()->getPage(page->page)->getDefaultCTM(tile->ctm, dpi, dpi,
+							rotate, false,
+							out->upsideDown());
+  tile->ctm[4] -= tile->xMin;
+  tile->ctm[5] -= tile->yMin;
+  invertMatrix(tile->ctm, tile->ictm);
+}
+
+void PDFCore::invertMatrix(double *m, double *mi) {
+  double det;
+
+  det = 1 / (m[0] * m[3] - m[1] * m[2]);
+  mi[0] = m[3] * det;
+  mi[1] = -m[1] * det;
+  mi[2] = -m[2] * det;
+  mi[3] = m[0] * det;
+  mi[4] = (m[2] * m[5] - m[3] * m[4]) * det;
+  mi[5] = (m[1] * m[4] - m[0] * m[5]) * det;
+}
+
+// Collect finished jobs from the render pool and draw them.
+void PDFCore::finishTiles() {
+  std::vector<std::unique_ptr<TileRenderJob>> jobs;
+  PDFCorePage *page;
+  PDFCoreTile *tile;
+  int w, h;
+
+  if (!renderPool->takeDone(jobs)) {
+    return;
+  }
+  for (auto& job: jobs) {
+    tile = NULL;
+    if ((page = findPage(job->page))) {
+      for (auto& t: page->tiles) {
+	if (t->renderID == job->id) {
+	  tile = t.get();
+	  break;
+	}
+      }
+    }
+    if (!tile) {
+      // a prefetched tile (or one that was discarded while the job was
+      // running)
+      for (auto it = tileCache.begin(); it != tileCache.end(); ++it) {
+	auto& cached = *it;
+	if (cached->renderID == job->id) {
+	  if (job->ok) {
+	    cached->renderID = 0;
+	    cached->bitmap = job->bitmap;
+	    job->bitmap = NULL;
+	    memcpy(cached->ctm, job->ctm, 6 * sizeof(double));
+	    memcpy(cached->ictm, job->ictm, 6 * sizeof(double));
+	  } else {
+	    tileCache.erase(it);
+	  }
+	  trimTileCache();
+	  break;
+	}
+      }
+      continue;
+    }
+    tile->renderID = 0;
+    if (job->ok) {
+      if (tile->bitmap) {
+	// discard the preview
+	delete tile->bitmap;
+      }
+      tile->bitmap = job->bitmap;
+      job->bitmap = NULL;
+      memcpy(tile->ctm, job->ctm, 6 * sizeof(double));
+      memcpy(tile->ictm, job->ictm, 6 * sizeof(double));
+    } else {
+      renderTile(page, tile);
+    }
+    w = tile->bitmap->getWidth();
+    if (w > tile->xMax - tile->xMin) {
+      w = tile->xMax - tile->xMin;
+    }
+    h = tile->bitmap->getHeight();
+    if (h > tile->yMax - tile->yMin) {
+      h = tile->yMax - tile->yMin;
+    }
+    clippedRedrawRect(tile, 0, 0, tile->xDest, tile->yDest, w, h,
+		      0, 0, drawAreaWidth, drawAreaHeight, true);
+    releaseTileBitmap(tile);
+  }
+  updateBusyCursor();
+}
+
+// Show the busy cursor while any tile in the window is still being
+// rendered -- tiles in the margin around the window, and prefetched
+// ones, don't count.
+void PDFCore::updateBusyCursor() {
+  for (auto& page: pages) {
+    for (auto& tile: page->tiles) {
+      if (tile->renderID &&
+	  tile->xDest < drawAreaWidth &&
+	  tile->xDest + (tile->xMax - tile->xMin) > 0 &&
+	  tile->yDest < drawAreaHeight &&
+	  tile->yDest + (tile->yMax - tile->yMin) > 0) {
+	setBusyCursor(true);
+	return;
+      }
+    }
+  }
+  setBusyCursor(false);
+}
+
+// Queue background renders for the pages the user is likely to look
+// at next, based on the direction they've been moving in.  These run
+// at low priority, and the results are kept in tileCache until
+// needTile() asks for them.
+void PDFCore::prefetch() {
+  std::vector<long long> dropped;
+  double dpiA;
+  int nPages, pg, pg0, pg1, rot, w, h, tileW, tileH, xDest, y0, y1;
+
+  // forget about queued prefetches -- the ones that are still wanted
+  // will be resubmitted below (anything already rendered stays in the
+  // cache until it ages out)
+  renderPool->dropPrefetch(dropped);
+  for (long long id: dropped) {
+    for (auto it = tileCache.begin(); it != tileCache.end(); ++it) {
+      if ((*it)->renderID == id) {
+	tileCache.erase(it);
+	break;
+      }
+    }
+  }
+
+  nPages = xpdfParams->getPrefetchPages();
+  if (!doc || topPage <= 0 || nPages <= 0 || !renderPool->canRender()) {
+    return;
+  }
+
+  // figure out which pages to prefetch: <nPages> in the direction of
+  // movement, plus one in the opposite direction
+  if (scrollDir > 0) {
+    pg0 = topPage - 1;
+    pg1 = midPage + nPages;
+  } else {
+    pg0 = topPage - nPages;
+    pg1 = midPage + 1;
+  }
+  if (pg0 < 1) {
+    pg0 = 1;
+  }
+  if (pg1 > doc->getNumPages()) {
+    pg1 = doc->getNumPages();
+  }
+
+  for (pg = pg0; pg <= pg1; ++pg) {
+    dpiA = getPageDPI(pg, zoom, rotate);
+    rot = rotate + doc->getPageRotate(pg);
+    if (rot >= 360) {
+      rot -= 360;
+    } else if (rot < 0) {
+      rot += 360;
+    }
+    getPageSize(pg, dpiA, rot, &w, &h, &tileW, &tileH);
+
+    if (continuousMode) {
+      // everything within the rasterized band (1.5 screens) is
+      // handled by update()
+      xDest = -scrollX;
+      if (w < maxPageW) {
+	xDest += (maxPageW - w) / 2;
+      }
+      if (maxPageW < drawAreaWidth) {
+	xDest += (drawAreaWidth - maxPageW) / 2;
+      }
+      y0 = 0;
+      y1 = h - 1;
+      if (pageY[pg - 1] + y0 < scrollY + drawAreaHeight + drawAreaHeight / 2 &&
+	  pageY[pg - 1] + y1 > scrollY - drawAreaHeight / 2) {
+	if (scrollDir > 0) {
+	  y0 = (int)(scrollY + drawAreaHeight + drawAreaHeight / 2
+		     - pageY[pg - 1]);
+	} else {
+	  y1 = (int)(scrollY - drawAreaHeight / 2 - pageY[pg - 1]);
+	}
+	if (y0 > y1) {
+	  continue;
+	}
+      }
+    } else {
+      // single-page mode: the page will be displayed starting at the
+      // top, with the current horizontal scroll position
+      if (pg == topPage) {
+	continue;
+      }
+      if (w < drawAreaWidth) {
+	xDest = (drawAreaWidth - w) / 2;
+      } else if (scrollX > w - drawAreaWidth) {
+	xDest = drawAreaWidth - w;
+      } else {
+	xDest = -scrollX;
+      }
+      y0 = 0;
+      y1 = drawAreaHeight + drawAreaHeight / 2;
+      if (y1 > h - 1) {
+	y1 = h - 1;
+      }
+    }
+    prefetchTiles(pg, dpiA, w, h, tileW, tileH, xDest, y0, y1);
+  }
+}
+
+// Queue prefetch jobs for the tiles of page <pg> that would be visible
+// with the page at <xDest> (in window coordinates) and covering rows
+// <yMin>..<yMax> (in page coordinates).
+void PDFCore::prefetchTiles(int pg, double dpiA, int w, int h,
+			    int tileW, int tileH, int xDest,
+			    int yMin, int yMax) {
+  PDFCorePage *page;
+  int x0, x1, y0, y1, x, y, sliceW, sliceH;
+  bool found;
+
+  if ((page = findPage(pg)) && fabs(dpiA - dpi) > 1e-8) {
+    page = NULL;
+  }
+
+  x0 = xDest;
+  x1 = x0 + w - 1;
+  if (x0 < -drawAreaWidth / 2) {
+    x0 = -drawAreaWidth / 2;
+  }
+  if (x1 > drawAreaWidth + drawAreaWidth / 2) {
+    x1 = drawAreaWidth + drawAreaWidth / 2;
+  }
+  x0 = ((x0 - xDest) / tileW) * tileW;
+  x1 = ((x1 - xDest) / tileW) * tileW;
+  y0 = (yMin / tileH) * tileH;
+  y1 = (yMax / tileH) * tileH;
+  for (y = y0; y <= y1; y += tileH) {
+    for (x = x0; x <= x1; x += tileW) {
+      sliceW = tileW;
+      if (x + sliceW > w) {
+	sliceW = w - x;
+      }
+      sliceH = tileH;
+      if (y + sliceH > h) {
+	sliceH = h - y;
+      }
+      if (sliceW <= 0 || sliceH <= 0) {
+	continue;
+      }
+      found = false;
+      if (page) {
+	for (auto& tile: page->tiles) {
+	  if (tile->xMin == x && tile->yMin == y) {
+	    found = true;
+	    break;
+	  }
+	}
+      }
+      if (found ||
+	  findCachedTile(pg, dpiA, x, y, x + sliceW, y + sliceH)) {
+	continue;
+      }
+      auto job = std::make_unique<TileRenderJob>();
+      job->id = ++lastRenderID;
+      job->page = pg;
+      job->dpi = dpiA;
+      job->rotate = rotate;
+      job->x = x;
+      job->y = y;
+      job->w = sliceW;
+      job->h = sliceH;
+      job->reverseVideo = reverseVideo;
+      job->tileFile = diskCache->getTileFile(pg, dpiA, rotate, x, y,
+					     sliceW, sliceH, reverseVideo);
+      job->prefetch = true;
+      auto cached = std::make_unique<PDFCoreCachedTile>();
+      cached->page = pg;
+      cached->dpi = dpiA;
+      cached->rotate = rotate;
+      cached->xMin = x;
+      cached->yMin = y;
+      cached->xMax = x + sliceW;
+      cached->yMax = y + sliceH;
+      cached->renderID = job->id;
+      tileCache.push_back(std::move(cached));
+      renderPool->submit(std::move(job));
+    }
   }
+}
 
-  xDest = x - scrollX;
-  if (continuousMode) {
-    yDest = y + pageY[page->page - 1] - scrollY;
-  } else {
-    yDest = y - scrollY;
-  }
-  if (continuousMode) {
-    if (page->w < maxPageW) {
-      xDest += (maxPageW - page->w) / 2;
+// Look up a tile in tileCache, and mark it as the most recently used.
+PDFCoreCachedTile *PDFCore::findCachedTile(int pg, double dpiA,
+					   int xMin, int yMin,
+					   int xMax, int yMax) {
+  for (auto it = tileCache.begin(); it != tileCache.end(); ++it) {
+    auto& cached = *it;
+    if (cached->page == pg && fabs(cached->dpi - dpiA) < 1e-8 &&
+	cached->rotate == rotate &&
+	cached->xMin == xMin && cached->yMin == yMin &&
+	cached->xMax == xMax && cached->yMax == yMax) {
+      std::rotate(it, it + 1, tileCache.end());
+      return tileCache.back().get();
     }
-    if (maxPageW < drawAreaWidth) {
-      xDest += (drawAreaWidth - maxPageW) / 2;
+  }
+  return NULL;
+}
+
+// Remove a tile from tileCache and return it (or NULL if it isn't
+// there).
+std::unique_ptr<PDFCoreCachedTile> PDFCore::takeCachedTile(
+			int pg, double dpiA, int xMin, int yMin,
+			int xMax, int yMax) {
+  PDFCoreCachedTile *p;
+  std::unique_ptr<PDFCoreCachedTile> cached;
+
+  if ((p = findCachedTile(pg, dpiA, xMin, yMin, xMax, yMax))) {
+    for (auto it = tileCache.begin(); it != tileCache.end(); ++it) {
+      if (it->get() == p) {
+	cached = std::move(*it);
+	tileCache.erase(it);
+	break;
+      }
     }
-  } else if (page->w < drawAreaWidth) {
-    xDest += (drawAreaWidth - page->w) / 2;
   }
-  if (continuousMode && totalDocH < drawAreaHeight) {
-    yDest += (drawAreaHeight - totalDocH) / 2;
-  } else if (!continuousMode && page->h < drawAreaHeight) {
-    yDest += (drawAreaHeight - page->h) / 2;
+  return cached;
+}
+
+// Move a displayed tile's bitmap into tileCache, so it can be reused
+// if the same part of the page is displayed again at the same
+// resolution.  Tiles that haven't been rendered yet (including ones
+// showing a preview) are cancelled instead.
+void PDFCore::cacheTile(PDFCorePage *page, PDFCoreTile *tile) {
+  if (tile->renderID) {
+    renderPool->cancel(tile->renderID);
+    tile->renderID = 0;
+    return;
   }
-  curTile = tile = newTile(xDest, yDest);
-  curPage = page;
-  tile->xMin = x;
-  tile->yMin = y;
-  tile->xMax = x + sliceW;
-  tile->yMax = y + sliceH;
-  tile->edges = 0;
-  if (tile->xMin == 0) {
-    tile->edges |= pdfCoreTileLeftEdge;
+  if (!tile->bitmap && !(tile->bitmap = restoreTileBitmap(tile))) {
+    return;
   }
-  if (tile->xMax == page->w) {
-    tile->edges |= pdfCoreTileRightEdge;
+  auto cached = std::make_unique<PDFCoreCachedTile>();
+  cached->page = page->page;
+  cached->dpi = dpi;
+  cached->rotate = rotate;
+  cached->xMin = tile->xMin;
+  cached->yMin = tile->yMin;
+  cached->xMax = tile->xMax;
+  cached->yMax = tile->yMax;
+  cached->bitmap = tile->bitmap;
+  tile->bitmap = NULL;
+  memcpy(cached->ctm, tile->ctm, 6 * sizeof(double));
+  memcpy(cached->ictm, tile->ictm, 6 * sizeof(double));
+  tileCache.push_back(std::move(cached));
+}
+
+void PDFCore::cachePageTiles(PDFCorePage *page) {
+  for (auto& tile: page->tiles) {
+    cacheTile(page, tile.get());
   }
-  if (continuousMode) {
-    if (tile->yMin == 0) {
-      tile->edges |= pdfCoreTileTopSpace;
-      if (page->page == 1) {
-	tile->edges |= pdfCoreTileTopEdge;
-      }
-    }
-    if (tile->yMax == page->h) {
-      tile->edges |= pdfCoreTileBottomSpace;
-      if (page->page == doc->getNumPages()) {
-	tile->edges |= pdfCoreTileBottomEdge;
-      }
-    }
-  } else {
-    if (tile->yMin == 0) {
-      tile->edges |= pdfCoreTileTopEdge;
-    }
-    if (tile->yMax == page->h) {
-      tile->edges |= pdfCoreTileBottomEdge;
+}
+
+// Evict the least recently used tiles from tileCache until it fits in
+// the memory budget.
+void PDFCore::trimTileCache() {
+  size_t maxBytes, nBytes;
+
+  maxBytes = (size_t)xpdfParams->getTileCacheSize() * 1024 * 1024;
+  nBytes = 0;
+  for (auto& cached: tileCache) {
+    if (cached->bitmap) {
+      nBytes += getBitmapBytes(cached->bitmap);
     }
   }
-  doc->displayPageSlice(out.get(), page->page, dpi, dpi, rotate,
-			false, true, false, x, y, sliceW, sliceH);
-  tile->bitmap = out->takeBitmap();
-  memcpy(tile->ctm, out->getDefCTM(), 6 * sizeof(double));
-  memcpy(tile->ictm, out->getDefICTM(), 6 * sizeof(double));
-  if (!page->links) {
-    page->links.reset(doc->getLinks(page->page));
-  }
-  if (!page->text) {
-    if ((textOut = new TextOutputDev(NULL, true, 0, false, false))) {
-      doc->displayPage(textOut, page->page, dpi, dpi, rotate,
-		       false, true, false);
-      page->text = textOut->takeText();
-      delete textOut;
+  auto it = tileCache.begin();
+  while (nBytes > maxBytes && it != tileCache.end()) {
+    if ((*it)->bitmap) {
+      nBytes -= getBitmapBytes((*it)->bitmap);
+      it = tileCache.erase(it);
+    } else {
+      ++it;
     }
   }
-  page->tiles.emplace_back(tile);
-  curTile = NULL;
-  curPage = NULL;
+}
 
-  setBusyCursor(false);
+size_t PDFCore::getBitmapBytes(SplashBitmap *bitmap) {
+  size_t n;
+
+  n = (size_t)bitmap->getRowSize() * bitmap->getHeight();
+  if (bitmap->getAlphaPtr()) {
+    n += (size_t)bitmap->getWidth() * bitmap->getHeight();
+  }
+  return n;
 }
 
 bool PDFCore::gotoNextPage(int inc, bool top) {
-  int pg, scrollYA;
+  long long scrollYA;
+  int pg;
 
   if (!doc || doc->getNumPages() == 0 || topPage >= doc->getNumPages()) {
     return false;
@@ -902,7 +1769,8 @@ bool PDFCore::gotoNextPage(int inc, bool top) {
 }
 
 bool PDFCore::gotoPrevPage(int dec, bool top, bool bottom) {
-  int pg, scrollYA;
+  long long scrollYA;
+  int pg;
 
   if (!doc || doc->getNumPages() == 0 || topPage <= 1) {
     return false;
@@ -1044,7 +1912,7 @@ void PDFCore::scrollPageDown() {
   }
 }
 
-void PDFCore::scrollTo(int x, int y) {
+void PDFCore::scrollTo(int x, long long y) {
   update(topPage, x, y < 0 ? 0 : y, zoom, rotate, false, false, false);
 }
 
@@ -1058,14 +1926,14 @@ void PDFCore::scrollToRightEdge() {
 }
 
 void PDFCore::scrollToTopEdge() {
-  int y;
+  long long y;
 
   y = continuousMode ? pageY[topPage - 1] : 0;
   update(topPage, scrollX, y, zoom, rotate, false, false, false);
 }
 
 void PDFCore::scrollToBottomEdge() {
-  int y = 0;
+  long long y = 0;
 
   for (auto it = pages.rbegin(); it != pages.rend(); it++) {
     const auto& page = *it;
@@ -1082,14 +1950,15 @@ void PDFCore::scrollToBottomEdge() {
 }
 
 void PDFCore::scrollToTopLeft() {
-  int y;
+  long long y;
 
   y = continuousMode ? pageY[topPage - 1] : 0;
   update(topPage, 0, y, zoom, rotate, false, false, false);
 }
 
 void PDFCore::scrollToBottomRight() {
-  int x = 0, y = 0;
+  long long y = 0;
+  int x = 0;
 
   for (auto it = pages.rbegin(); it != pages.rend(); it++) {
     const auto& page = *it;
@@ -1108,7 +1977,8 @@ void PDFCore::scrollToBottomRight() {
 
 void PDFCore::zoomToRect(int pg, double ulx, double uly,
 			 double lrx, double lry) {
-  int x0, y0, x1, y1, u, sx, sy;
+  long long sy;
+  int x0, y0, x1, y1, u, sx;
   double rx, ry, newZoom, t;
   PDFCorePage *p;
 
@@ -1132,7 +2002,7 @@ void PDFCore::zoomToRect(int pg, double ulx, double uly,
 	sx += (int)(0.5 * rx * (maxPageW - p->w));
       }
       u = (pg - 1) * continuousModePageSpacing;
-      sy += (int)(rx * (pageY[pg - 1] - u)) + u;
+      sy += (long long)(rx * (pageY[pg - 1] - u)) + u;
     }
   } else {
     newZoom = ry * (dpi / (0.01 * 72));
@@ -1144,22 +2014,27 @@ void PDFCore::zoomToRect(int pg, double ulx, double uly,
 	sx += (int)(0.5 * rx * (maxPageW - p->w));
       }
       u = (pg - 1) * continuousModePageSpacing;
-      sy += (int)(ry * (pageY[pg - 1] - u)) + u;
+      sy += (long long)(ry * (pageY[pg - 1] - u)) + u;
     }
   }
   update(pg, sx, sy, newZoom, rotate, false, false, false);
 }
 
 void PDFCore::zoomCentered(double zoomA) {
-  int sx, sy, rot, hAdjust, vAdjust, i;
-  double dpi1, dpi2, pageW, pageH;
+  long long sy;
+  int sx, rot, hAdjust, vAdjust, i;
+  double dpi1, dpi2, pageW, pageH, uw, uh;
+
+  // a new zoom picks up any page sizes learned since the last layout
+  fitPageW = maxUnscaledPageW;
+  fitPageH = maxUnscaledPageH;
 
   if (zoomA == zoomPage) {
     if (continuousMode) {
-      pageW = (rotate == 90 || rotate == 270) ? maxUnscaledPageH
-	                                      : maxUnscaledPageW;
-      pageH = (rotate == 90 || rotate == 270) ? maxUnscaledPageW
-	                                      : maxUnscaledPageH;
+      pageW = (rotate == 90 || rotate == 270) ? fitPageH
+	                                      : fitPageW;
+      pageH = (rotate == 90 || rotate == 270) ? fitPageW
+	                                      : fitPageH;
       dpi1 = 72.0 * (double)drawAreaWidth / pageW;
       dpi2 = 72.0 * (double)(drawAreaHeight - continuousModePageSpacing) /
 	     pageH;
@@ -1174,8 +2049,8 @@ void PDFCore::zoomCentered(double zoomA) {
 
   } else if (zoomA == zoomWidth) {
     if (continuousMode) {
-      pageW = (rotate == 90 || rotate == 270) ? maxUnscaledPageH
-	                                      : maxUnscaledPageW;
+      pageW = (rotate == 90 || rotate == 270) ? fitPageH
+	                                      : fitPageW;
     } else {
       rot = rotate + doc->getPageRotate(topPage);
       if (rot >= 360) {
@@ -1191,8 +2066,8 @@ void PDFCore::zoomCentered(double zoomA) {
 
   } else if (zoomA == zoomHeight) {
     if (continuousMode) {
-      pageH = (rotate == 90 || rotate == 270) ? maxUnscaledPageW
-	                                      : maxUnscaledPageH;
+      pageH = (rotate == 90 || rotate == 270) ? fitPageW
+	                                      : fitPageH;
       dpi1 = 72.0 * (double)(drawAreaHeight - continuousModePageSpacing) / pageH;
     } else {
       rot = rotate + doc->getPageRotate(topPage);
@@ -1230,24 +2105,15 @@ void PDFCore::zoomCentered(double zoomA) {
     // we compute the pageY values at the new zoom level instead
     sy = 0;
     for (i = 1; i < topPage; ++i) {
-      rot = rotate + doc->getPageRotate(i);
-      if (rot >= 360) {
-	rot -= 360;
-      } else if (rot < 0) {
-	rot += 360;
-      }
-      if (rot == 90 || rot == 270) {
-	sy += (int)((doc->getPageCropWidth(i) * dpi1) / 72 + 0.5);
-      } else {
-	sy += (int)((doc->getPageCropHeight(i) * dpi1) / 72 + 0.5);
-      }
+      getUnscaledPageSize(i, rotate, &uw, &uh);
+      sy += (int)((uh * dpi1) / 72 + 0.5);
     }
     vAdjust = (topPage - 1) * continuousModePageSpacing;
     sy = sy + (int)((scrollY - pageY[topPage - 1] + drawAreaHeight / 2)
 		    * (dpi1 / dpi))
          + vAdjust - drawAreaHeight / 2;
   } else {
-    sy = (int)((scrollY + drawAreaHeight / 2) * (dpi1 / dpi))
+    sy = (long long)((scrollY + drawAreaHeight / 2) * (dpi1 / dpi))
          - drawAreaHeight / 2;
   }
 
@@ -1257,8 +2123,9 @@ void PDFCore::zoomCentered(double zoomA) {
 // Zoom so that the current page(s) fill the window width.  Maintain
 // the vertical center.
 void PDFCore::zoomToCurrentWidth() {
-  double w, maxW, dpi1;
-  int sx, sy, vAdjust, rot, i;
+  double w, maxW, dpi1, uw, uh;
+  long long sy;
+  int sx, vAdjust, rot, i;
 
   // compute the maximum page width of visible pages
   rot = rotate + doc->getPageRotate(topPage);
@@ -1276,17 +2143,7 @@ void PDFCore::zoomToCurrentWidth() {
     for (i = topPage + 1;
 	 i < doc->getNumPages() && pageY[i-1] < scrollY + drawAreaHeight;
 	 ++i) {
-      rot = rotate + doc->getPageRotate(i);
-      if (rot >= 360) {
-	rot -= 360;
-      } else if (rot < 0) {
-	rot += 360;
-      }
-      if (rot == 90 || rot == 270) {
-	w = doc->getPageCropHeight(i);
-      } else {
-	w = doc->getPageCropWidth(i);
-      }
+      getUnscaledPageSize(i, rotate, &w, &uh);
       if (w > maxW) {
 	maxW = w;
       }
@@ -1310,24 +2167,15 @@ void PDFCore::zoomToCurrentWidth() {
     // we compute the pageY values at the new zoom level instead
     sy = 0;
     for (i = 1; i < topPage; ++i) {
-      rot = rotate + doc->getPageRotate(i);
-      if (rot >= 360) {
-	rot -= 360;
-      } else if (rot < 0) {
-	rot += 360;
-      }
-      if (rot == 90 || rot == 270) {
-	sy += (int)((doc->getPageCropWidth(i) * dpi1) / 72 + 0.5);
-      } else {
-	sy += (int)((doc->getPageCropHeight(i) * dpi1) / 72 + 0.5);
-      }
+      getUnscaledPageSize(i, rotate, &uw, &uh);
+      sy += (int)((uh * dpi1) / 72 + 0.5);
     }
     vAdjust = (topPage - 1) * continuousModePageSpacing;
     sy = sy + (int)((scrollY - pageY[topPage - 1] + drawAreaHeight / 2)
 		    * (dpi1 / dpi))
          + vAdjust - drawAreaHeight / 2;
   } else {
-    sy = (int)((scrollY + drawAreaHeight / 2) * (dpi1 / dpi))
+    sy = (long long)((scrollY + drawAreaHeight / 2) * (dpi1 / dpi))
          - drawAreaHeight / 2;
   }
 
@@ -1349,31 +2197,21 @@ void PDFCore::setSelectionColor(SplashColor color) {
 void PDFCore::setSelection(int newSelectPage,
 			   int newSelectULX, int newSelectULY,
 			   int newSelectLRX, int newSelectLRY) {
-  int x0, y0, x1, y1, py;
+  long long sy, py;
+  int x0, y0, x1, y1;
   bool haveSel, newHaveSel;
   bool needRedraw, needScroll;
   bool moveLeft, moveRight, moveTop, moveBottom;
+  int oldSelectPage, oldSelectULX, oldSelectULY, oldSelectLRX, oldSelectLRY;
   PDFCorePage *page;
 
 
   haveSel = selectULX != selectLRX && selectULY != selectLRY;
   newHaveSel = newSelectULX != newSelectLRX && newSelectULY != newSelectLRY;
 
-  // erase old selection on off-screen bitmap
-  needRedraw = false;
-  if (haveSel) {
-    xorRectangle(selectPage, selectULX, selectULY, selectLRX, selectLRY,
-		 new SplashSolidColor(selectXorColor));
-    needRedraw = true;
-  }
-
-  // draw new selection on off-screen bitmap
-  if (newHaveSel) {
-    xorRectangle(newSelectPage, newSelectULX, newSelectULY,
-		 newSelectLRX, newSelectLRY,
-		 new SplashSolidColor(selectXorColor));
-    needRedraw = true;
-  }
+  // the selection is drawn over the tiles by clippedRedrawRect(), so
+  // changing it only needs a redraw
+  needRedraw = haveSel || newHaveSel;
 
   // check which edges moved
   if (!haveSel || newSelectPage != selectPage) {
@@ -1385,7 +2223,19 @@ void PDFCore::setSelection(int newSelectPage,
     moveBottom = newSelectLRY != selectLRY;
   }
 
-  // redraw currently visible part of bitmap
+  // switch to new selection coords
+  oldSelectPage = selectPage;
+  oldSelectULX = selectULX;
+  oldSelectULY = selectULY;
+  oldSelectLRX = selectLRX;
+  oldSelectLRY = selectLRY;
+  selectPage = newSelectPage;
+  selectULX = newSelectULX;
+  selectULY = newSelectULY;
+  selectLRX = newSelectLRX;
+  selectLRY = newSelectLRY;
+
+  // redraw the area that changed
   if (needRedraw) {
     if (!haveSel) {
       page = findPage(newSelectPage);
@@ -1396,64 +2246,67 @@ void PDFCore::setSelection(int newSelectPage,
       redrawWindow(page->xDest + x0, page->yDest + y0,
 		   x1 - x0 + 1, y1 - y0 + 1, false);
     } else if (!newHaveSel) {
-      if ((page = findPage(selectPage))) {
-	x0 = selectULX;
-	y0 = selectULY;
-	x1 = selectLRX;
-	y1 = selectLRY;
+      if ((page = findPage(oldSelectPage))) {
+	x0 = oldSelectULX;
+	y0 = oldSelectULY;
+	x1 = oldSelectLRX;
+	y1 = oldSelectLRY;
 	redrawWindow(page->xDest + x0, page->yDest + y0,
 		     x1 - x0 + 1, y1 - y0 + 1, false);
       }
+    } else if (newSelectPage != oldSelectPage) {
+      if ((page = findPage(oldSelectPage))) {
+	redrawWindow(page->xDest + oldSelectULX, page->yDest + oldSelectULY,
+		     oldSelectLRX - oldSelectULX + 1,
+		     oldSelectLRY - oldSelectULY + 1, false);
+      }
+      page = findPage(newSelectPage);
+      redrawWindow(page->xDest + newSelectULX, page->yDest + newSelectULY,
+		   newSelectLRX - newSelectULX + 1,
+		   newSelectLRY - newSelectULY + 1, false);
     } else {
       page = findPage(newSelectPage);
       if (moveLeft) {
-	x0 = newSelectULX < selectULX ? newSelectULX : selectULX;
-	y0 = newSelectULY < selectULY ? newSelectULY : selectULY;
-	x1 = newSelectULX > selectULX ? newSelectULX : selectULX;
-	y1 = newSelectLRY > selectLRY ? newSelectLRY : selectLRY;
+	x0 = newSelectULX < oldSelectULX ? newSelectULX : oldSelectULX;
+	y0 = newSelectULY < oldSelectULY ? newSelectULY : oldSelectULY;
+	x1 = newSelectULX > oldSelectULX ? newSelectULX : oldSelectULX;
+	y1 = newSelectLRY > oldSelectLRY ? newSelectLRY : oldSelectLRY;
 	redrawWindow(page->xDest + x0, page->yDest + y0,
 		     x1 - x0 + 1, y1 - y0 + 1, false);
       }
       if (moveRight) {
-	x0 = newSelectLRX < selectLRX ? newSelectLRX : selectLRX;
-	y0 = newSelectULY < selectULY ? newSelectULY : selectULY;
-	x1 = newSelectLRX > selectLRX ? newSelectLRX : selectLRX;
-	y1 = newSelectLRY > selectLRY ? newSelectLRY : selectLRY;
+	x0 = newSelectLRX < oldSelectLRX ? newSelectLRX : oldSelectLRX;
+	y0 = newSelectULY < oldSelectULY ? newSelectULY : oldSelectULY;
+	x1 = newSelectLRX > oldSelectLRX ? newSelectLRX : oldSelectLRX;
+	y1 = newSelectLRY > oldSelectLRY ? newSelectLRY : oldSelectLRY;
 	redrawWindow(page->xDest + x0, page->yDest + y0,
 		     x1 - x0 + 1, y1 - y0 + 1, false);
       }
       if (moveTop) {
-	x0 = newSelectULX < selectULX ? newSelectULX : selectULX;
-	y0 = newSelectULY < selectULY ? newSelectULY : selectULY;
-	x1 = newSelectLRX > selectLRX ? newSelectLRX : selectLRX;
-	y1 = newSelectULY > selectULY ? newSelectULY : selectULY;
+	x0 = newSelectULX < oldSelectULX ? newSelectULX : oldSelectULX;
+	y0 = newSelectULY < oldSelectULY ? newSelectULY : oldSelectULY;
+	x1 = newSelectLRX > oldSelectLRX ? newSelectLRX : oldSelectLRX;
+	y1 = newSelectULY > oldSelectULY ? newSelectULY : oldSelectULY;
 	redrawWindow(page->xDest + x0, page->yDest + y0,
 		     x1 - x0 + 1, y1 - y0 + 1, false);
       }
       if (moveBottom) {
-	x0 = newSelectULX < selectULX ? newSelectULX : selectULX;
-	y0 = newSelectLRY < selectLRY ? newSelectLRY : selectLRY;
-	x1 = newSelectLRX > selectLRX ? newSelectLRX : selectLRX;
-	y1 = newSelectLRY > selectLRY ? newSelectLRY : selectLRY;
+	x0 = newSelectULX < oldSelectULX ? newSelectULX : oldSelectULX;
+	y0 = newSelectLRY < oldSelectLRY ? newSelectLRY : oldSelectLRY;
+	x1 = newSelectLRX > oldSelectLRX ? newSelectLRX : oldSelectLRX;
+	y1 = newSelectLRY > oldSelectLRY ? newSelectLRY : oldSelectLRY;
 	redrawWindow(page->xDest + x0, page->yDest + y0,
 		     x1 - x0 + 1, y1 - y0 + 1, false);
       }
     }
   }
 
-  // switch to new selection coords
-  selectPage = newSelectPage;
-  selectULX = newSelectULX;
-  selectULY = newSelectULY;
-  selectLRX = newSelectLRX;
-  selectLRY = newSelectLRY;
-
   // scroll if necessary
   if (newHaveSel) {
     page = findPage(selectPage);
     needScroll = false;
     x0 = scrollX;
-    y0 = scrollY;
+    sy = scrollY;
     if (moveLeft && page->xDest + selectULX < 0) {
       x0 += page->xDest + selectULX;
       needScroll = true;
@@ -1468,21 +2321,21 @@ void PDFCore::setSelection(int newSelectPage,
       needScroll = true;
     }
     py = continuousMode ? pageY[selectPage - 1] : 0;
-    if (moveTop && py + selectULY < y0) {
-      y0 = py + selectULY;
+    if (moveTop && py + selectULY < sy) {
+      sy = py + selectULY;
       needScroll = true;
-    } else if (moveBottom && py + selectLRY >= y0 + drawAreaHeight) {
-      y0 = py + selectLRY - drawAreaHeight;
+    } else if (moveBottom && py + selectLRY >= sy + drawAreaHeight) {
+      sy = py + selectLRY - drawAreaHeight;
       needScroll = true;
-    } else if (moveTop && py + selectULY >= y0 + drawAreaHeight) {
-      y0 = py + selectULY - drawAreaHeight;
+    } else if (moveTop && py + selectULY >= sy + drawAreaHeight) {
+      sy = py + selectULY - drawAreaHeight;
       needScroll = true;
-    } else if (moveBottom && py + selectLRY < y0) {
-      y0 = py + selectLRY;
+    } else if (moveBottom && py + selectLRY < sy) {
+      sy = py + selectLRY;
       needScroll = true;
     }
     if (needScroll) {
-      scrollTo(x0, y0);
+      scrollTo(x0, sy);
     }
   }
 }
@@ -1540,57 +2393,6 @@ void PDFCore::moveSelection(int pg, int x, int y) {
 	       newSelectLRX, newSelectLRY);
 }
 
-void PDFCore::xorRectangle(int pg, int x0, int y0, int x1, int y1,
-			   SplashPattern *pattern, PDFCoreTile *oneTile) {
-  Splash *splash;
-  SplashPath *path;
-  PDFCorePage *page;
-  SplashCoord xx0, yy0, xx1, yy1;
-  int xi, yi, wi, hi;
-
-  if ((page = findPage(pg))) {
-    for (auto& tile: page->tiles) {
-      if (!oneTile || tile.get() == oneTile) {
-	splash = new Splash(tile->bitmap, false);
-	splash->setFillPattern(pattern->copy());
-	xx0 = (SplashCoord)(x0 - tile->xMin);
-	yy0 = (SplashCoord)(y0 - tile->yMin);
-	xx1 = (SplashCoord)(x1 - tile->xMin);
-	yy1 = (SplashCoord)(y1 - tile->yMin);
-	path = new SplashPath();
-	path->moveTo(xx0, yy0);
-	path->lineTo(xx1, yy0);
-	path->lineTo(xx1, yy1);
-	path->lineTo(xx0, yy1);
-	path->close();
-	splash->xorFill(path, true);
-	delete path;
-	delete splash;
-	xi = x0 - tile->xMin;
-	wi = x1 - x0;
-	if (xi < 0) {
-	  wi += xi;
-	  xi = 0;
-	}
-	if (xi + wi > tile->bitmap->getWidth()) {
-	  wi = tile->bitmap->getWidth() - xi;
-	}
-	yi = y0 - tile->yMin;
-	hi = y1 - y0;
-	if (yi < 0) {
-	  hi += yi;
-	  yi = 0;
-	}
-	if (yi + hi > tile->bitmap->getHeight()) {
-	  hi = tile->bitmap->getHeight() - yi;
-	}
-	updateTileData(tile.get(), xi, yi, wi, hi, true);
-      }
-    }
-  }
-  delete pattern;
-}
-
 bool PDFCore::getSelection(int *pg, double *ulx, double *uly,
 			   double *lrx, double *lry) {
   if (selectULX == selectLRX || selectULY == selectLRY) {
@@ -1604,49 +2406,35 @@ bool PDFCore::getSelection(int *pg, double *ulx, double *uly,
 
 GooString *PDFCore::extractText(int pg, double xMin, double yMin,
 			      double xMax, double yMax) {
-  PDFCorePage *page;
-  TextOutputDev *textOut;
-  int x0, y0, x1, y1, t;
-  GooString *s;
+  TextPage *text;
+  double ctm[6];
+  double x0, y0, x1, y1, t;
 
 #ifdef ENFORCE_PERMISSIONS
   if (!doc->okToCopy()) {
     return NULL;
   }
 #endif
-  if ((page = findPage(pg))) {
-    cvtUserToDev(pg, xMin, yMin, &x0, &y0);
-    cvtUserToDev(pg, xMax, yMax, &x1, &y1);
-    if (x0 > x1) {
-      t = x0; x0 = x1; x1 = t;
-    }
-    if (y0 > y1) {
-      t = y0; y0 = y1; y1 = t;
-    }
-    s = page->text->getText(x0, y0, x1, y1
+  if (!(text = getTextPage(pg))) {
+    return new GooString();
+  }
+  doc->getCatalog()->getPage(pg)->getDefaultCTM(ctm, 72, 72, 0, false,
+						out->upsideDown());
+  x0 = ctm[0] * xMin + ctm[2] * yMin + ctm[4];
+  y0 = ctm[1] * xMin + ctm[3] * yMin + ctm[5];
+  x1 = ctm[0] * xMax + ctm[2] * yMax + ctm[4];
+  y1 = ctm[1] * xMax + ctm[3] * yMax + ctm[5];
+  if (x0 > x1) {
+    t = x0; x0 = x1; x1 = t;
+  }
+  if (y0 > y1) {
+    t = y0; y0 = y1; y1 = t;
+  }
+  return text->getText(x0, y0, x1, y1
 #ifdef TEXTPAGE_GETTEXT_EOL
-                            , eolUnix
+                       , eolUnix
 #endif
-    );
-  } else {
-    textOut = new TextOutputDev(NULL, true, 0, false, false);
-    if (textOut->isOk()) {
-      doc->displayPage(textOut, pg, dpi, dpi, rotate, false, true, false);
-      textOut->cvtUserToDev(xMin, yMin, &x0, &y0);
-      textOut->cvtUserToDev(xMax, yMax, &x1, &y1);
-      if (x0 > x1) {
-	t = x0; x0 = x1; x1 = t;
-      }
-      if (y0 > y1) {
-	t = y0; y0 = y1; y1 = t;
-      }
-      s = textOut->getText(x0, y0, x1, y1);
-    } else {
-      s = new GooString();
-    }
-    delete textOut;
-  }
-  return s;
+  );
 }
 
 bool PDFCore::find(const char *s, bool caseSensitive, bool next, bool backward,
@@ -1677,8 +2465,9 @@ bool PDFCore::findU(Unicode *u, int len, bool caseSensitive,
 		    bool next, bool backward, bool wholeWord,
 		    bool onePageOnly) {
   TextOutputDev *textOut;
-  double xMin, yMin, xMax, yMax;
-  PDFCorePage *page;
+  TextPage *text;
+  double xMin, yMin, xMax, yMax, selXMin, selYMin, selXMax, selYMax, d;
+  double xd0, yd0, xd1, yd1;
   int pg;
   bool startAtTop, startAtLast, stopAtLast;
 
@@ -1690,29 +2479,36 @@ bool PDFCore::findU(Unicode *u, int len, bool caseSensitive,
   setBusyCursor(true);
 
   // search current page starting at previous result, current
-  // selection, or top/bottom of page
+  // selection, or top/bottom of page (the text layer is at 72 dpi, so
+  // the selection has to be converted, and nudged by one device pixel)
   startAtTop = startAtLast = false;
   xMin = yMin = xMax = yMax = 0;
+  selXMin = selYMin = selXMax = selYMax = 0;
   pg = topPage;
   if (next) {
     startAtLast = true;
   } else if (selectULX != selectLRX && selectULY != selectLRY) {
     pg = selectPage;
+    cvtDevToTextRect(pg, selectULX, selectULY, selectLRX, selectLRY,
+		     &selXMin, &selYMin, &selXMax, &selYMax);
+    d = 72 / dpi;
     if (backward) {
-      xMin = selectULX - 1;
-      yMin = selectULY - 1;
+      xMin = selXMin - d;
+      yMin = selYMin - d;
     } else {
-      xMin = selectULX + 1;
-      yMin = selectULY + 1;
+      xMin = selXMin + d;
+      yMin = selYMin + d;
     }
   } else {
     startAtTop = true;
   }
-  if (!(page = findPage(pg))) {
+  if (!findPage(pg)) {
     displayPage(pg, zoom, rotate, true, false);
-    page = findPage(pg);
   }
-  if (page->text->findText(u, len, startAtTop, true, startAtLast, false,
+  if (!(text = getTextPage(pg))) {
+    goto notFound;
+  }
+  if (text->findText(u, len, startAtTop, true, startAtLast, false,
 			   caseSensitive, backward, false,
 			   &xMin, &yMin, &xMax, &yMax)) {
     goto found;
@@ -1762,10 +2558,10 @@ bool PDFCore::findU(Unicode *u, int len, bool caseSensitive,
       stopAtLast = true;
     } else {
       stopAtLast = false;
-      xMax = selectLRX;
-      yMax = selectLRY;
+      xMax = selXMax;
+      yMax = selYMax;
     }
-    if (page->text->findText(u, len, true, false, false, stopAtLast,
+    if (text->findText(u, len, true, false, false, stopAtLast,
 			     caseSensitive, backward, false,
 			     &xMin, &yMin, &xMax, &yMax)) {
       goto found;
@@ -1781,18 +2577,19 @@ bool PDFCore::findU(Unicode *u, int len, bool caseSensitive,
  foundPage:
   update(pg, scrollX, continuousMode ? -1 : 0, zoom, rotate, false, true,
 	 true);
-  page = findPage(pg);
-  if (!page->text->findText(u, len, true, true, false, false,
-			    caseSensitive, backward, false,
-			    &xMin, &yMin, &xMax, &yMax)) {
+  if (!(text = getTextPage(pg)) ||
+      !text->findText(u, len, true, true, false, false,
+		      caseSensitive, backward, false,
+		      &xMin, &yMin, &xMax, &yMax)) {
     // this can happen if coalescing is bad
     goto notFound;
   }
 
   // found: change the selection
  found:
-  setSelection(pg, (int)floor(xMin), (int)floor(yMin),
-	       (int)ceil(xMax), (int)ceil(yMax));
+  cvtTextToDevRect(pg, xMin, yMin, xMax, yMax, &xd0, &yd0, &xd1, &yd1);
+  setSelection(pg, (int)floor(xd0), (int)floor(yd0),
+	       (int)ceil(xd1), (int)ceil(yd1));
 
   setBusyCursor(false);
   return true;
@@ -1801,20 +2598,16 @@ bool PDFCore::findU(Unicode *u, int len, bool caseSensitive,
 
 bool PDFCore::cvtWindowToUser(int xw, int yw,
 			      int *pg, double *xu, double *yu) {
-  for (auto& page: pages) {
-    if (xw >= page->xDest && xw < page->xDest + page->w &&
-	yw >= page->yDest && yw < page->yDest + page->h) {
-      if (page->tiles.empty()) {
-	break;
-      }
-      auto &tile = page->tiles[0];
-      *pg = page->page;
-      xw -= tile->xDest;
-      yw -= tile->yDest;
-      *xu = tile->ictm[0] * xw + tile->ictm[2] * yw + tile->ictm[4];
-      *yu = tile->ictm[1] * xw + tile->ictm[3] * yw + tile->ictm[5];
-      return true;
-    }
+  PDFCorePage *page;
+
+  if ((page = findPageAtWindow(xw, yw)) && !page->tiles.empty()) {
+    auto &tile = page->tiles[0];
+    *pg = page->page;
+    xw -= tile->xDest;
+    yw -= tile->yDest;
+    *xu = tile->ictm[0] * xw + tile->ictm[2] * yw + tile->ictm[4];
+    *yu = tile->ictm[1] * xw + tile->ictm[3] * yw + tile->ictm[5];
+    return true;
   }
   *pg = 0;
   *xu = *yu = 0;
@@ -1822,14 +2615,13 @@ bool PDFCore::cvtWindowToUser(int xw, int yw,
 }
 
 bool PDFCore::cvtWindowToDev(int xw, int yw, int *pg, int *xd, int *yd) {
-  for (auto& page: pages) {
-    if (xw >= page->xDest && xw < page->xDest + page->w &&
-	yw >= page->yDest && yw < page->yDest + page->h) {
-      *pg = page->page;
-      *xd = xw - page->xDest;
-      *yd = yw - page->yDest;
-      return true;
-    }
+  PDFCorePage *page;
+
+  if ((page = findPageAtWindow(xw, yw))) {
+    *pg = page->page;
+    *xd = xw - page->xDest;
+    *yd = yw - page->yDest;
+    return true;
   }
   *pg = 0;
   *xd = *yd = 0;
@@ -1918,7 +2710,11 @@ void PDFCore::cvtDevToUser(int pg, int xd, int yd, double *xu, double *yu) {
 }
 
 void PDFCore::setReverseVideo(bool reverseVideoA) {
+  reverseVideo = reverseVideoA;
   out->setReverseVideo(reverseVideoA);
+  renderPool->cancelAll();
+  pages.clear();
+  tileCache.clear();
   update(topPage, scrollX, scrollY, zoom, rotate, true, false, false);
 }
 
@@ -1937,15 +2733,143 @@ LinkAction *PDFCore::findLink(int pg, double x, double y) {
   return NULL;
 }
 
+// The pages list is always a consecutive run of pages (or a single
+// page), so the page can be indexed directly.
 PDFCorePage *PDFCore::findPage(int pg) {
-  for (auto& page: pages) {
-    if (page->page == pg) {
-      return page.get();
-    }
+  size_t i;
+
+  if (pages.empty() || pg < pages.front()->page) {
+    return NULL;
+  }
+  i = pg - pages.front()->page;
+  if (i < pages.size() && pages[i]->page == pg) {
+    return pages[i].get();
+  }
+  return NULL;
+}
+
+// Return the page that contains document y coordinate <y> in
+// continuous mode, i.e., the last page that starts at or above <y>
+// (the page above, for a point in the spacing between pages).
+int PDFCore::findPageAtY(long long y) {
+  int pg;
+
+  pg = (int)(std::upper_bound(pageY.begin(), pageY.end(), y)
+	     - pageY.begin());
+  return pg < 1 ? 1 : pg;
+}
+
+// Return the page under window position (<xw>,<yw>), or NULL if
+// there is no page there.
+PDFCorePage *PDFCore::findPageAtWindow(int xw, int yw) {
+  PDFCorePage *page;
+
+  if (pages.empty()) {
+    return NULL;
+  }
+  if (continuousMode) {
+    // all pages share the same offset between window and document
+    // coordinates
+    page = pages.front().get();
+    page = findPage(findPageAtY(yw - page->yDest + pageY[page->page - 1]));
+  } else {
+    page = pages.front().get();
+  }
+  if (page && xw >= page->xDest && xw < page->xDest + page->w &&
+      yw >= page->yDest && yw < page->yDest + page->h) {
+    return page;
   }
   return NULL;
 }
 
+// Return the text layer for page <pg>, extracting it if necessary.
+// Text is only needed for selection, copying, and find, so this is
+// done on demand rather than when the page is rasterized.
+TextPage *PDFCore::getTextPage(int pg) {
+  TextOutputDev *textOut;
+  TextPage *text;
+
+  for (auto it = textPages.begin(); it != textPages.end(); ++it) {
+    if ((*it)->page == pg) {
+      std::rotate(it, it + 1, textPages.end());
+      return textPages.back()->text;
+    }
+  }
+
+  text = NULL;
+  textOut = new TextOutputDev(NULL, true, 0, false, false);
+  if (textOut->isOk()) {
+    doc->displayPage(textOut, pg, 72, 72, 0, false, true, false);
+    text = textOut->takeText();
+  }
+  delete textOut;
+  if (!text) {
+    return NULL;
+  }
+
+  if (textPages.size() >= pdfCoreTextCacheSize) {
+    textPages.erase(textPages.begin());
+  }
+  textPages.push_back(std::make_unique<PDFCoreText>(pg, text));
+  return text;
+}
+
+// Compute the transform from text layer coordinates (72 dpi,
+// unrotated) to device space at the current zoom and rotation.
+void PDFCore::getTextToDevMatrix(int pg, double *m) {
+  Page *page;
+  double textCTM[6], textICTM[6], devCTM[6];
+
+  page = doc->getCatalog()->getPage(pg);
+  page->getDefaultCTM(textCTM, 72, 72, 0, false, out->upsideDown());
+  page->getDefaultCTM(devCTM, dpi, dpi, rotate, false, out->upsideDown());
+  invertMatrix(textCTM, textICTM);
+  m[0] = textICTM[0] * devCTM[0] + textICTM[1] * devCTM[2];
+  m[1] = textICTM[0] * devCTM[1] + textICTM[1] * devCTM[3];
+  m[2] = textICTM[2] * devCTM[0] + textICTM[3] * devCTM[2];
+  m[3] = textICTM[2] * devCTM[1] + textICTM[3] * devCTM[3];
+  m[4] = textICTM[4] * devCTM[0] + textICTM[5] * devCTM[2] + devCTM[4];
+  m[5] = textICTM[4] * devCTM[1] + textICTM[5] * devCTM[3] + devCTM[5];
+}
+
+// Convert a device space rectangle to text layer coordinates.  The
+// result is normalized so that (xt0,yt0) is the upper-left corner.
+void PDFCore::cvtDevToTextRect(int pg, int xd0, int yd0, int xd1, int yd1,
+			       double *xt0, double *yt0,
+			       double *xt1, double *yt1) {
+  double m[6], mi[6], xa, ya, xb, yb;
+
+  getTextToDevMatrix(pg, m);
+  invertMatrix(m, mi);
+  xa = mi[0] * xd0 + mi[2] * yd0 + mi[4];
+  ya = mi[1] * xd0 + mi[3] * yd0 + mi[5];
+  xb = mi[0] * xd1 + mi[2] * yd1 + mi[4];
+  yb = mi[1] * xd1 + mi[3] * yd1 + mi[5];
+  *xt0 = xa < xb ? xa : xb;
+  *yt0 = ya < yb ? ya : yb;
+  *xt1 = xa < xb ? xb : xa;
+  *yt1 = ya < yb ? yb : ya;
+}
+
+// Convert a text layer rectangle to device space.  The result is
+// normalized so that (xd0,yd0) is the upper-left corner.
+void PDFCore::cvtTextToDevRect(int pg, double xt0, double yt0,
+			       double xt1, double yt1,
+			       double *xd0, double *yd0,
+			       double *xd1, double *yd1) {
+  double m[6], xa, ya, xb, yb;
+
+  getTextToDevMatrix(pg, m);
+  xa = m[0] * xt0 + m[2] * yt0 + m[4];
+  ya = m[1] * xt0 + m[3] * yt0 + m[5];
+  xb = m[0] * xt1 + m[2] * yt1 + m[4];
+  yb = m[1] * xt1 + m[3] * yt1 + m[5];
+  *xd0 = xa < xb ? xa : xb;
+  *yd0 = ya < yb ? ya : yb;
+  *xd1 = xa < xb ? xb : xa;
+  *yd1 = ya < yb ? yb : ya;
+}
+
 void PDFCore::redrawCbk(void *data, int x0, int y0, int x1, int y1,
 			bool composited) {
   PDFCore *core = (PDFCore *)data;
@@ -1974,9 +2898,22 @@ void PDFCore::redrawCbk(void *data, int x0, int y0, int x1, int y1,
 			  true, composited);
 }
 
+// Redraw part of the window.  Unless tiles need to be updated first,
+// this is left to the subclass if it can collect the damaged areas and
+// paint them later, all at once.
 void PDFCore::redrawWindow(int x, int y, int width, int height,
 			   bool needUpdate) {
-  int xDest, yDest, w;
+  if (!needUpdate && addDamage(x, y, width, height)) {
+    return;
+  }
+  drawWindow(x, y, width, height, needUpdate);
+}
+
+// Draw part of the window: the tiles that overlap it, and the matte
+// around them.
+void PDFCore::drawWindow(int x, int y, int width, int height,
+			 bool needUpdate) {
+  int xDest, yDest, w, h;
 
   if (pages.empty()) {
     redrawRect(NULL, 0, 0, x, y, width, height, true);
@@ -2047,8 +2984,15 @@ void PDFCore::redrawWindow(int x, int y, int width, int height,
 			  drawAreaWidth - xDest, tile->yMax - tile->yMin,
 			  x, y, width, height, false);
       }
-      clippedRedrawRect(tile.get(), 0, 0, tile->xDest, tile->yDest,
-			tile->bitmap->getWidth(), tile->bitmap->getHeight(),
+      if (tile->bitmap) {
+	w = tile->bitmap->getWidth();
+	h = tile->bitmap->getHeight();
+      } else {
+	// still being rendered
+	w = tile->xMax - tile->xMin;
+	h = tile->yMax - tile->yMin;
+      }
+      clippedRedrawRect(tile.get(), 0, 0, tile->xDest, tile->yDest, w, h,
 			x, y, width, height, needUpdate);
     }
   }
@@ -2062,11 +3006,63 @@ void PDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 			     int width, int height, bool composited) {
 }
 
+// Called once a tile's bitmap is complete and has been passed to
+// updateTileData().  A subclass that keeps an exact copy of the
+// bitmap's pixels can free the bitmap (and set tile->bitmap to NULL),
+// so that only one copy is kept.
+void PDFCore::releaseTileBitmap(PDFCoreTile *tileA) {
+}
+
+// Rebuild a bitmap released by releaseTileBitmap().  Returns NULL if
+// the tile has no pixels.
+SplashBitmap *PDFCore::restoreTileBitmap(PDFCoreTile *tileA) {
+  return NULL;
+}
+
+// Move the contents of the window by (<dx>, <dy>), for scrolling, and
+// redraw anything that couldn't be moved.  Returns false if this isn't
+// supported, in which case the whole window is redrawn.
+bool PDFCore::scrollWindow(int dx, int dy) {
+  return false;
+}
+
+// Draw the selection over part of the window.
+void PDFCore::drawSelection(int xDest, int yDest, int width, int height) {
+}
+
+// Draw the part of the selection that's on the part of <tile> just
+// drawn.
+void PDFCore::clippedDrawSelection(PDFCoreTile *tile, int xSrc, int ySrc,
+				   int xDest, int yDest,
+				   int width, int height) {
+  int x0, y0, x1, y1;
+
+  x0 = xDest - xSrc + selectULX - tile->xMin;
+  y0 = yDest - ySrc + selectULY - tile->yMin;
+  x1 = xDest - xSrc + selectLRX - tile->xMin;
+  y1 = yDest - ySrc + selectLRY - tile->yMin;
+  if (x0 < xDest) {
+    x0 = xDest;
+  }
+  if (y0 < yDest) {
+    y0 = yDest;
+  }
+  if (x1 > xDest + width) {
+    x1 = xDest + width;
+  }
+  if (y1 > yDest + height) {
+    y1 = yDest + height;
+  }
+  if (x0 < x1 && y0 < y1) {
+    drawSelection(x0, y0, x1 - x0, y1 - y0);
+  }
+}
+
 void PDFCore::clippedRedrawRect(PDFCoreTile *tile, int xSrc, int ySrc,
 				int xDest, int yDest, int width, int height,
 				int xClip, int yClip, int wClip, int hClip,
 				bool needUpdate, bool composited) {
-  if (tile && needUpdate) {
+  if (tile && tile->bitmap && needUpdate) {
     updateTileData(tile, xSrc, ySrc, width, height, composited);
   }
   if (xDest < xClip) {
@@ -2085,7 +3081,15 @@ void PDFCore::clippedRedrawRect(PDFCoreTile *tile, int xSrc, int ySrc,
   if (yDest + height > yClip + hClip) {
     height = yClip + hClip - yDest;
   }
-  if (width > 0 && height > 0) {
-    redrawRect(tile, xSrc, ySrc, xDest, yDest, width, height, composited);
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  redrawRect(tile, xSrc, ySrc, xDest, yDest, width, height, composited);
+
+  // draw the selection over the tile -- this never touches the tile's
+  // pixels
+  if (tile && tile->page == selectPage &&
+      selectULX != selectLRX && selectULY != selectLRY) {
+    clippedDrawSelection(tile, xSrc, ySrc, xDest, yDest, width, height);
   }
 }
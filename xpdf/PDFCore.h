@@ -11,6 +11,7 @@
 
 #include <poppler-config.h>
 
+#include <deque>
 #include <memory>
 #include <stdlib.h>
 #include <string>
@@ -21,7 +22,6 @@
 
 class GooString;
 class SplashBitmap;
-class SplashPattern;
 class BaseStream;
 class PDFDoc;
 class Links;
@@ -32,6 +32,8 @@ class HighlightFile;
 class CoreOutputDev;
 class PDFCore;
 class PDFCoreTile;
+class TileRenderPool;
+class DiskTileCache;
 
 //------------------------------------------------------------------------
 // zoom factor
@@ -58,19 +60,38 @@ class PDFCorePage {
 public:
 
   PDFCorePage(int pageA, int wA, int hA, int tileWA, int tileHA);
-  ~PDFCorePage();
 
   int page;
   std::vector<std::unique_ptr<PDFCoreTile>> tiles;
 				// cached tiles
   int xDest, yDest;		// position of upper-left corner
 				//   in the drawing area
+  bool placed;			// set once xDest/yDest have been set
   int w, h;			// size of whole page bitmap
   int tileW, tileH;		// size of tiles
   std::unique_ptr<Links> links;	// hyperlinks for this page
-  TextPage *text;		// extracted text
 };
 
+//------------------------------------------------------------------------
+// PDFCoreText
+//------------------------------------------------------------------------
+
+// The text layer for one page.  This is extracted at 72 dpi with no
+// (extra) rotation, so it can be used at any zoom level -- see
+// PDFCore::getTextToDevMatrix().
+class PDFCoreText {
+public:
+
+  PDFCoreText(int pageA, TextPage *textA);
+  ~PDFCoreText();
+
+  int page;
+  TextPage *text;
+};
+
+// Maximum number of text layers to keep.
+#define pdfCoreTextCacheSize 32
+
 //------------------------------------------------------------------------
 // PDFCoreTile
 //------------------------------------------------------------------------
@@ -81,13 +102,40 @@ public:
   PDFCoreTile(int xDestA, int yDestA);
   virtual ~PDFCoreTile();
 
+  int page;
   int xMin, yMin, xMax, yMax;
   int xDest, yDest;
   unsigned int edges;
-  SplashBitmap *bitmap;
+  SplashBitmap *bitmap;		// rendered tile, or a rescaled preview
+				//   while renderID is set; NULL once
+				//   released by releaseTileBitmap()
   double ctm[6];		// coordinate transform matrix:
 				//   default user space -> device space
   double ictm[6];		// inverse CTM
+  long long renderID;		// background render job for this tile
+				//   (0 if not pending)
+};
+
+//------------------------------------------------------------------------
+// PDFCoreCachedTile
+//------------------------------------------------------------------------
+
+// A tile that isn't currently part of the display: either rendered (or
+// being rendered) ahead of time, or kept from an earlier view.
+class PDFCoreCachedTile {
+public:
+
+  PDFCoreCachedTile();
+  ~PDFCoreCachedTile();
+
+  int page;
+  double dpi;
+  int rotate;
+  int xMin, yMin, xMax, yMax;
+  SplashBitmap *bitmap;		// NULL while the render is pending
+  double ctm[6];
+  double ictm[6];
+  long long renderID;		// background render job (0 if done)
 };
 
 #define pdfCoreTileTopEdge      0x01
@@ -97,6 +145,22 @@ public:
 #define pdfCoreTileTopSpace     0x10
 #define pdfCoreTileBottomSpace  0x20
 
+//------------------------------------------------------------------------
+// PDFCorePageSize
+//------------------------------------------------------------------------
+
+// Unscaled size of a page, as given by the document.  To avoid
+// loading the whole page tree when a document is opened, pages are
+// assumed to be the same size as page 1 until they're looked at.
+struct PDFCorePageSize {
+  double w, h;			// crop box size, in points
+  int rotate;			// page's /Rotate value
+  bool known;			// false if this is an estimate
+};
+
+// Number of page sizes looked up per call to PDFCore::scanPageSizes().
+#define pdfCorePageScanChunk 200
+
 //------------------------------------------------------------------------
 // PDFHistory
 //------------------------------------------------------------------------
@@ -155,7 +219,7 @@ public:
 			   bool addToHist);
 
   // Update the display, given the specified parameters.
-  virtual void update(int topPageA, int scrollXA, int scrollYA,
+  virtual void update(int topPageA, int scrollXA, long long scrollYA,
 		      double zoomA, int rotateA, bool force,
 		      bool addToHist, bool adjustScrollX);
 
@@ -174,7 +238,7 @@ public:
   virtual void scrollDownNextPage(int nLines = 16);
   virtual void scrollPageUp();
   virtual void scrollPageDown();
-  virtual void scrollTo(int x, int y);
+  virtual void scrollTo(int x, long long y);
   virtual void scrollToLeftEdge();
   virtual void scrollToRightEdge();
   virtual void scrollToTopEdge();
@@ -242,7 +306,7 @@ public:
   bool canGoBack() { return historyBLen > 1; }
   bool canGoForward() { return historyFLen > 0; }
   int getScrollX() { return scrollX; }
-  int getScrollY() { return scrollY; }
+  long long getScrollY() { return scrollY; }
   int getDrawAreaWidth() { return drawAreaWidth; }
   int getDrawAreaHeight() { return drawAreaHeight; }
   virtual void setBusyCursor(bool busy) = 0;
@@ -250,21 +314,64 @@ public:
 
 protected:
 
-  int loadFile2(PDFDoc *newDoc);
+  int loadFile2(PDFDoc *newDoc, const std::string *ownerPassword = NULL,
+		const std::string *userPassword = NULL);
+  void initPageSizes();
+  void learnPageSize(int pg);
+  void getUnscaledPageSize(int pg, int rotateA, double *w, double *h);
+  void layoutPages();
+  bool scanPageSizes();
+  double getPageDPI(int pg, double zoomA, int rotateA);
+  void getPageSize(int pg, double dpiA, int rot, int *w, int *h,
+		   int *tileW, int *tileH);
   void addPage(int pg, int rot);
   void needTile(PDFCorePage *page, int x, int y);
-  void xorRectangle(int pg, int x0, int y0, int x1, int y1,
-		    SplashPattern *pattern, PDFCoreTile *oneTile = NULL);
+  void renderTile(PDFCorePage *page, PDFCoreTile *tile);
+  void setTileCTM(PDFCorePage *page, PDFCoreTile *tile);
+  void showPreview(PDFCorePage *page, PDFCoreTile *tile);
+  void finishTiles();
+  void updateBusyCursor();
+  void prefetch();
+  void prefetchTiles(int pg, double dpiA, int w, int h, int tileW, int tileH,
+		     int xDest, int yMin, int yMax);
+  PDFCoreCachedTile *findCachedTile(int pg, double dpiA, int xMin, int yMin,
+				    int xMax, int yMax);
+  std::unique_ptr<PDFCoreCachedTile> takeCachedTile(int pg, double dpiA,
+						    int xMin, int yMin,
+						    int xMax, int yMax);
+  void cacheTile(PDFCorePage *page, PDFCoreTile *tile);
+  void cachePageTiles(PDFCorePage *page);
+  void trimTileCache();
+  static size_t getBitmapBytes(SplashBitmap *bitmap);
   int loadHighlightFile(HighlightFile *hf, SplashColorPtr color,
 			SplashColorPtr selectColor, bool selectable);
   PDFCorePage *findPage(int pg);
+  int findPageAtY(long long y);
+  PDFCorePage *findPageAtWindow(int xw, int yw);
+  TextPage *getTextPage(int pg);
+  void getTextToDevMatrix(int pg, double *m);
+  void cvtDevToTextRect(int pg, int xd0, int yd0, int xd1, int yd1,
+			double *xt0, double *yt0, double *xt1, double *yt1);
+  void cvtTextToDevRect(int pg, double xt0, double yt0,
+			double xt1, double yt1,
+			double *xd0, double *yd0, double *xd1, double *yd1);
+  static void invertMatrix(double *m, double *mi);
   static void redrawCbk(void *data, int x0, int y0, int x1, int y1,
 			bool composited);
   void redrawWindow(int x, int y, int width, int height,
 		    bool needUpdate);
+  void drawWindow(int x, int y, int width, int height,
+		  bool needUpdate);
+  virtual bool addDamage(int x, int y, int width, int height)
+    { return false; }
   virtual PDFCoreTile *newTile(int xDestA, int yDestA);
   virtual void updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 			      int width, int height, bool composited);
+  virtual void releaseTileBitmap(PDFCoreTile *tileA);
+  virtual SplashBitmap *restoreTileBitmap(PDFCoreTile *tileA);
+  virtual void drawSelection(int xDest, int yDest, int width, int height);
+  void clippedDrawSelection(PDFCoreTile *tile, int xSrc, int ySrc,
+			    int xDest, int yDest, int width, int height);
   virtual void redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 			  int xDest, int yDest, int width, int height,
 			  bool composited) = 0;
@@ -272,6 +379,7 @@ protected:
 			 int xDest, int yDest, int width, int height,
 			 int xClip, int yClip, int wClip, int hClip,
 			 bool needUpdate, bool composited = true);
+  virtual bool scrollWindow(int dx, int dy);
   virtual void updateScrollbars() = 0;
   virtual bool checkForNewFile() { return false; }
 
@@ -280,18 +388,28 @@ protected:
 				//   continuous mode
   int drawAreaWidth,		// size of the PDF display area
       drawAreaHeight;
-  double maxUnscaledPageW,	// maximum unscaled page size
-         maxUnscaledPageH;
+  double maxUnscaledPageW,	// maximum unscaled page size (of the
+         maxUnscaledPageH;	//   pages whose sizes are known)
+  double fitPageW,		// maxUnscaledPageW/H as of the last
+         fitPageH;		//   layout the user asked for -- used for
+				//   the continuous mode fit zooms, so that
+				//   scanning page sizes doesn't change the
+				//   resolution
+  std::vector<PDFCorePageSize> pageSizes;
+				// unscaled size of each page
+  int pageSizeScanPos;		// next page for scanPageSizes()
+  bool pageLayoutStale;		// set when a page size turns out to be
+				//   different from its estimate
   int maxPageW;			// maximum page width (only used in
 				//   continuous mode)
-  int totalDocH;		// total document height (only used in
+  long long totalDocH;		// total document height (only used in
 				//   continuous mode)
-  std::vector<int> pageY;	// top coordinates for each page (only used
+  std::vector<long long> pageY;	// top coordinates for each page (only used
 				//   in continuous mode)
   int topPage;			// page at top of window
   int midPage;			// page at middle of window
-  int scrollX, scrollY;		// offset from top left corner of topPage
-				//   to top left corner of window
+  int scrollX;			// offset from top left corner of topPage
+  long long scrollY;		//   to top left corner of window
   double zoom;			// current zoom level, in percent of 72 dpi
   double dpi;			// current zoom level, in DPI
   int rotate;			// current page rotation
@@ -315,13 +433,34 @@ protected:
                                 //   current entry
 
 
-  std::vector<std::unique_ptr<PDFCorePage>> pages;
-				// cached pages
+  std::deque<std::unique_ptr<PDFCorePage>> pages;
+				// cached pages, in page order (in
+				//   continuous mode, a consecutive run)
   PDFCoreTile *curTile;		// tile currently being rasterized
   PDFCorePage *curPage;		// page to which curTile belongs
 
+  std::vector<std::unique_ptr<PDFCoreText>> textPages;
+				// text layers, least recently used first
+
+  SplashColorMode colorMode;
+  int bitmapRowPad;
   SplashColor paperColor;
+  bool reverseVideo;
+  int tileSize;			// tile width and height, in pixels (0 =
+				//   based on the window size)
   std::unique_ptr<CoreOutputDev> out;
+  std::unique_ptr<DiskTileCache> diskCache;
+				// rendered tiles saved between runs (must
+				//   outlive renderPool)
+  std::unique_ptr<TileRenderPool> renderPool;
+				// background tile rasterizer
+  long long lastRenderID;	// last render job ID handed out
+  std::vector<std::unique_ptr<PDFCoreCachedTile>> tileCache;
+				// tiles that aren't currently displayed
+				//   (prefetched, or scrolled/zoomed away),
+				//   least recently used first
+  int scrollDir;		// direction of the most recent movement:
+				//   1 = forward, -1 = backward
 
   friend class PDFCoreTile;
 };
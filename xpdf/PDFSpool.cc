@@ -0,0 +1,160 @@
+//========================================================================
+//
+// PDFSpool.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "Error.h"
+#include "PDFSpool.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Amount of data read from the input at a time.
+#define spoolReadSize 65536
+
+// The linearization dictionary must be within this many bytes of the
+// start of the file.
+#define spoolLinearizedSize 1024
+
+//------------------------------------------------------------------------
+// PDFSpool
+//------------------------------------------------------------------------
+
+PDFSpool::PDFSpool(int inFDA) {
+  const char *dir;
+  std::string tmpName;
+  char buf[32];
+
+  inFD = inFDA;
+  length = openedLength = 0;
+  firstPageEnd = -1;
+  checkedLinearized = false;
+  done = false;
+
+  if (!(dir = getenv("TMPDIR")) || !dir[0]) {
+    dir = "/tmp";
+  }
+  tmpName = std::string(dir) + "/xpdfXXXXXX";
+  if ((tmpFD = mkstemp(&tmpName[0])) < 0) {
+    error(errIO, -1, "Couldn't create temporary file in '{0:s}'", dir);
+    return;
+  }
+  unlink(tmpName.c_str());
+  fcntl(tmpFD, F_SETFD, FD_CLOEXEC);
+  snprintf(buf, sizeof(buf), "/dev/fd/%d", tmpFD);
+  fileName = buf;
+}
+
+PDFSpool::~PDFSpool() {
+  if (inFD >= 0) {
+    close(inFD);
+  }
+  if (tmpFD >= 0) {
+    close(tmpFD);
+  }
+}
+
+bool PDFSpool::read() {
+  char buf[spoolReadSize];
+  ssize_t n, m, i;
+
+  if (done) {
+    return false;
+  }
+  if ((n = ::read(inFD, buf, sizeof(buf))) < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+      return true;
+    }
+    error(errIO, -1, "Error reading PDF data");
+    n = 0;
+  }
+  if (n == 0) {
+    done = true;
+    close(inFD);
+    inFD = -1;
+    return false;
+  }
+  for (i = 0; i < n; i += m) {
+    if ((m = write(tmpFD, buf + i, n - i)) <= 0) {
+      if (m < 0 && errno == EINTR) {
+	m = 0;
+	continue;
+      }
+      error(errIO, -1, "Error writing temporary file");
+      done = true;
+      close(inFD);
+      inFD = -1;
+      return false;
+    }
+    length += m;
+  }
+  if (!checkedLinearized && length >= spoolLinearizedSize) {
+    checkLinearized();
+  }
+  return true;
+}
+
+bool PDFSpool::readyToOpen() {
+  if (length <= openedLength) {
+    return false;
+  }
+  if (done) {
+    return true;
+  }
+  if (!checkedLinearized || firstPageEnd < 0) {
+    return false;
+  }
+  if (openedLength == 0) {
+    return length >= firstPageEnd;
+  }
+  // each reopen starts from scratch, so only reopen once the amount of
+  // data has doubled, to keep the total work proportional to the file
+  // size
+  return length >= 2 * openedLength;
+}
+
+// Look for a linearization dictionary at the start of the file, and
+// get the offset of the end of the first page (/E) from it.
+void PDFSpool::checkLinearized() {
+  char buf[spoolLinearizedSize + 1];
+  char *p, *end;
+  ssize_t n;
+
+  checkedLinearized = true;
+  if ((n = pread(tmpFD, buf, spoolLinearizedSize, 0)) <= 0) {
+    return;
+  }
+  // the header comment usually contains binary characters, but never
+  // nulls
+  for (p = buf; p < buf + n; ++p) {
+    if (!*p) {
+      *p = ' ';
+    }
+  }
+  buf[n] = '\0';
+  if (!(p = strstr(buf, "/Linearized"))) {
+    return;
+  }
+  if ((end = strstr(p, ">>"))) {
+    *end = '\0';
+  }
+  for (p = strstr(p, "/E"); p; p = strstr(p + 2, "/E")) {
+    if (isspace(p[2] & 0xff)) {
+      firstPageEnd = strtoll(p + 2, NULL, 10);
+      if (firstPageEnd <= 0) {
+	firstPageEnd = -1;
+      }
+      return;
+    }
+  }
+}
@@ -0,0 +1,78 @@
+//========================================================================
+//
+// PDFSpool.h
+//
+// Copies a PDF file arriving on a pipe into a temporary file, so it
+// can be viewed before all of it has arrived.
+//
+//========================================================================
+
+#ifndef PDFSPOOL_H
+#define PDFSPOOL_H
+
+#include <poppler-config.h>
+
+#include <string>
+#include "config.h"
+
+//------------------------------------------------------------------------
+// PDFSpool
+//------------------------------------------------------------------------
+
+// The temporary file is deleted as soon as it is created; it is
+// reached through its /dev/fd name, which (unlike the pipe) can be
+// opened any number of times, and read at any position, by Poppler.
+//
+// A linearized ("fast web view") file has everything needed to display
+// its first page near the start, so it is worth opening as soon as
+// that part has arrived, and again as more arrives.  Any other file is
+// only opened once all of it has arrived.
+class PDFSpool {
+public:
+
+  // Spool the data read from <inFDA>, which the spool takes ownership
+  // of.
+  PDFSpool(int inFDA);
+  ~PDFSpool();
+
+  // Returns true if the temporary file was created.
+  bool isOk() { return tmpFD >= 0; }
+
+  // Name to open the spooled document with.
+  const std::string& getFileName() { return fileName; }
+
+  // File descriptor that the data is read from.
+  int getInputFD() { return inFD; }
+
+  // Read whatever data is available (blocking, unless the input is in
+  // non-blocking mode).  Returns false when the end of the input is
+  // reached (or it can't be read).
+  bool read();
+
+  // Returns true when all of the data has arrived.
+  bool isDone() { return done; }
+
+  // Returns true if enough new data has arrived that the document
+  // should be (re)opened.
+  bool readyToOpen();
+
+  // Note that the document is being (re)opened with the data that has
+  // arrived so far.
+  void setOpened() { openedLength = length; }
+
+private:
+
+  void checkLinearized();
+
+  int inFD;			// input (pipe)
+  int tmpFD;			// temporary file
+  std::string fileName;		// /dev/fd name of the temporary file
+  long long length;		// amount of data spooled so far
+  long long openedLength;	// length at the last (re)open
+  long long firstPageEnd;	// end of the first page, for linearized
+				//   files; -1 otherwise
+  bool checkedLinearized;
+  bool done;
+};
+
+#endif
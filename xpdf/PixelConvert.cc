@@ -0,0 +1,357 @@
+//========================================================================
+//
+// PixelConvert.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include <string.h>
+#include "PixelConvert.h"
+#include "config.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PIXELCONVERT_X86 1
+#include <immintrin.h>
+#endif
+
+//------------------------------------------------------------------------
+
+// Converts <n> opaque RGB8 pixels.
+typedef void (*OpaqueFunc)(unsigned char *dst, const unsigned char *rgb,
+			   int n);
+
+// Blends <n> 32-bit pixels in <dst> with <paper> (a pixel in the same
+// format), using the alpha values in <alpha>.
+typedef void (*Blend32Func)(unsigned char *dst, const unsigned char *alpha,
+			    const unsigned char *paper, int n);
+
+static OpaqueFunc opaqueFuncs[4];
+static Blend32Func blend32Func;
+
+// Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
+static inline unsigned char div255(int x) {
+  return (unsigned char)((x + (x >> 8) + 0x80) >> 8);
+}
+
+//------------------------------------------------------------------------
+// scalar
+//------------------------------------------------------------------------
+
+template <PixelFormat format>
+static inline void putPixel(unsigned char *dst, int r, int g, int b) {
+  unsigned int px32;
+  unsigned short px16;
+
+  switch (format) {
+  case pixelFormatXRGB32:
+    px32 = ((unsigned int)r << 16) | ((unsigned int)g << 8) | b;
+    memcpy(dst, &px32, 4);
+    break;
+  case pixelFormatXBGR32:
+    px32 = ((unsigned int)b << 16) | ((unsigned int)g << 8) | r;
+    memcpy(dst, &px32, 4);
+    break;
+  case pixelFormatRGB565:
+    px16 = (unsigned short)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+    memcpy(dst, &px16, 2);
+    break;
+  default:
+    break;
+  }
+}
+
+template <PixelFormat format>
+static void convertScalar(unsigned char *dst, const unsigned char *rgb,
+			  const unsigned char *alpha,
+			  const unsigned char *paper, int n) {
+  int bpp, r, g, b, a, i;
+
+  bpp = format == pixelFormatRGB565 ? 2 : 4;
+  for (i = 0; i < n; ++i) {
+    r = rgb[0];
+    g = rgb[1];
+    b = rgb[2];
+    if (alpha) {
+      a = alpha[i];
+      r = div255((255 - a) * paper[0] + a * r);
+      g = div255((255 - a) * paper[1] + a * g);
+      b = div255((255 - a) * paper[2] + a * b);
+    }
+    putPixel<format>(dst, r, g, b);
+    rgb += 3;
+    dst += bpp;
+  }
+}
+
+template <PixelFormat format>
+static void convertOpaqueScalar(unsigned char *dst, const unsigned char *rgb,
+				int n) {
+  convertScalar<format>(dst, rgb, NULL, NULL, n);
+}
+
+static void blend32Scalar(unsigned char *dst, const unsigned char *alpha,
+			  const unsigned char *paper, int n) {
+  int a, i, k;
+
+  for (i = 0; i < n; ++i) {
+    a = alpha[i];
+    for (k = 0; k < 3; ++k) {
+      dst[k] = div255((255 - a) * paper[k] + a * dst[k]);
+    }
+    dst += 4;
+  }
+}
+
+//------------------------------------------------------------------------
+// x86 SIMD
+//------------------------------------------------------------------------
+
+#ifdef PIXELCONVERT_X86
+
+// Byte shuffle that turns four RGB8 pixels (in the low 12 bytes) into
+// four 32-bit pixels.  x86 is little-endian, so 0x00RRGGBB is stored as
+// B, G, R, 0.
+#define xrgbShuffle 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+#define xbgrShuffle 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1
+
+// Convert 16 pixels (48 bytes) at a time.
+template <PixelFormat format>
+__attribute__((target("ssse3")))
+static void convert32SSSE3(unsigned char *dst, const unsigned char *rgb,
+			   int n) {
+  __m128i mask, v0, v1, v2;
+  int i;
+
+  if (format == pixelFormatXRGB32) {
+    mask = _mm_setr_epi8(xrgbShuffle);
+  } else {
+    mask = _mm_setr_epi8(xbgrShuffle);
+  }
+  for (i = 0; i + 16 <= n; i += 16) {
+    v0 = _mm_loadu_si128((const __m128i *)(rgb + 3 * i));
+    v1 = _mm_loadu_si128((const __m128i *)(rgb + 3 * i + 16));
+    v2 = _mm_loadu_si128((const __m128i *)(rgb + 3 * i + 32));
+    _mm_storeu_si128((__m128i *)(dst + 4 * i),
+		     _mm_shuffle_epi8(v0, mask));
+    _mm_storeu_si128((__m128i *)(dst + 4 * i + 16),
+		     _mm_shuffle_epi8(_mm_alignr_epi8(v1, v0, 12), mask));
+    _mm_storeu_si128((__m128i *)(dst + 4 * i + 32),
+		     _mm_shuffle_epi8(_mm_alignr_epi8(v2, v1, 8), mask));
+    _mm_storeu_si128((__m128i *)(dst + 4 * i + 48),
+		     _mm_shuffle_epi8(_mm_srli_si128(v2, 4), mask));
+  }
+  convertScalar<format>(dst + 4 * i, rgb + 3 * i, NULL, NULL, n - i);
+}
+
+// Convert 8 pixels at a time.  Each 32-byte load only uses 24 bytes,
+// so the loop stops early enough not to read past the end of the row.
+template <PixelFormat format>
+__attribute__((target("avx2")))
+static void convert32AVX2(unsigned char *dst, const unsigned char *rgb,
+			  int n) {
+  __m256i mask, perm, v;
+  int i;
+
+  if (format == pixelFormatXRGB32) {
+    mask = _mm256_setr_epi8(xrgbShuffle, xrgbShuffle);
+  } else {
+    mask = _mm256_setr_epi8(xbgrShuffle, xbgrShuffle);
+  }
+  // move bytes 12-23 into the upper lane
+  perm = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+  for (i = 0; i + 11 <= n; i += 8) {
+    v = _mm256_loadu_si256((const __m256i *)(rgb + 3 * i));
+    v = _mm256_permutevar8x32_epi32(v, perm);
+    _mm256_storeu_si256((__m256i *)(dst + 4 * i),
+			_mm256_shuffle_epi8(v, mask));
+  }
+  // the compiler doesn't do this here -- without it, the SSE code run
+  // afterward (e.g., blend32SSE2) is several times slower
+  _mm256_zeroupper();
+  convert32SSSE3<format>(dst + 4 * i, rgb + 3 * i, n - i);
+}
+
+// Pack four 32-bit 0x00BBGGRR pixels into 5-6-5 bits, less 0x8000
+// (packs_epi32 saturates to signed 16-bit values, so the range is
+// shifted down first, and back up after packing).
+__attribute__((target("ssse3")))
+static inline __m128i to565SSSE3(__m128i d) {
+  d = _mm_or_si128(
+	_mm_or_si128(_mm_and_si128(_mm_slli_epi32(d, 8),
+				   _mm_set1_epi32(0xf800)),
+		     _mm_and_si128(_mm_srli_epi32(d, 5),
+				   _mm_set1_epi32(0x07e0))),
+	_mm_and_si128(_mm_srli_epi32(d, 19), _mm_set1_epi32(0x001f)));
+  return _mm_sub_epi32(d, _mm_set1_epi32(0x8000));
+}
+
+// Convert 16 pixels at a time: expand to 32 bits as for XBGR32, then
+// pack the channels into 16 bits.
+__attribute__((target("ssse3")))
+static void convert565SSSE3(unsigned char *dst, const unsigned char *rgb,
+			    int n) {
+  __m128i mask, bias, v0, v1, v2, d0, d1, d2, d3;
+  int i;
+
+  mask = _mm_setr_epi8(xbgrShuffle);
+  bias = _mm_set1_epi16((short)0x8000);
+  for (i = 0; i + 16 <= n; i += 16) {
+    v0 = _mm_loadu_si128((const __m128i *)(rgb + 3 * i));
+    v1 = _mm_loadu_si128((const __m128i *)(rgb + 3 * i + 16));
+    v2 = _mm_loadu_si128((const __m128i *)(rgb + 3 * i + 32));
+    d0 = to565SSSE3(_mm_shuffle_epi8(v0, mask));
+    d1 = to565SSSE3(_mm_shuffle_epi8(_mm_alignr_epi8(v1, v0, 12), mask));
+    d2 = to565SSSE3(_mm_shuffle_epi8(_mm_alignr_epi8(v2, v1, 8), mask));
+    d3 = to565SSSE3(_mm_shuffle_epi8(_mm_srli_si128(v2, 4), mask));
+    _mm_storeu_si128((__m128i *)(dst + 2 * i),
+		     _mm_add_epi16(_mm_packs_epi32(d0, d1), bias));
+    _mm_storeu_si128((__m128i *)(dst + 2 * i + 16),
+		     _mm_add_epi16(_mm_packs_epi32(d2, d3), bias));
+  }
+  convertScalar<pixelFormatRGB565>(dst + 2 * i, rgb + 3 * i, NULL, NULL,
+				   n - i);
+}
+
+// Blend 4 pixels at a time, in 16-bit lanes.
+__attribute__((target("sse2")))
+static void blend32SSE2(unsigned char *dst, const unsigned char *alpha,
+			const unsigned char *paper, int n) {
+  __m128i zero, c255, c128, paper16, px, a, aLo, aHi, tLo, tHi;
+  int paper32, alpha32, i;
+
+  zero = _mm_setzero_si128();
+  c255 = _mm_set1_epi16(255);
+  c128 = _mm_set1_epi16(0x80);
+  memcpy(&paper32, paper, 4);
+  paper16 = _mm_unpacklo_epi8(_mm_set1_epi32(paper32), zero);
+  for (i = 0; i + 4 <= n; i += 4) {
+    // most pixels are either fully opaque or fully transparent
+    memcpy(&alpha32, alpha + i, 4);
+    if (alpha32 == -1) {
+      continue;
+    }
+    if (alpha32 == 0) {
+      _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_set1_epi32(paper32));
+      continue;
+    }
+    px = _mm_loadu_si128((const __m128i *)(dst + 4 * i));
+    a = _mm_cvtsi32_si128(alpha32);
+    a = _mm_unpacklo_epi8(a, a);
+    a = _mm_unpacklo_epi16(a, a);
+    aLo = _mm_unpacklo_epi8(a, zero);
+    aHi = _mm_unpackhi_epi8(a, zero);
+    tLo = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(c255, aLo), paper16),
+			_mm_mullo_epi16(aLo, _mm_unpacklo_epi8(px, zero)));
+    tHi = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(c255, aHi), paper16),
+			_mm_mullo_epi16(aHi, _mm_unpackhi_epi8(px, zero)));
+    // same rounding as div255()
+    tLo = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(tLo,
+						     _mm_srli_epi16(tLo, 8)),
+				       c128), 8);
+    tHi = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(tHi,
+						     _mm_srli_epi16(tHi, 8)),
+				       c128), 8);
+    _mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_packus_epi16(tLo, tHi));
+  }
+  blend32Scalar(dst + 4 * i, alpha + i, paper, n - i);
+}
+
+#endif // PIXELCONVERT_X86
+
+//------------------------------------------------------------------------
+// converters
+//------------------------------------------------------------------------
+
+// The 32-bit formats are just a rearrangement of the bytes, so blending
+// can be done after conversion, in place.
+template <PixelFormat format>
+static void convert32(unsigned char *dst, const unsigned char *rgb,
+		      const unsigned char *alpha, const unsigned char *paper,
+		      int n) {
+  unsigned char paperPixel[4];
+
+  (*opaqueFuncs[format])(dst, rgb, n);
+  if (alpha) {
+    putPixel<format>(paperPixel, paper[0], paper[1], paper[2]);
+    (*blend32Func)(dst, alpha, paperPixel, n);
+  }
+}
+
+static void convert565(unsigned char *dst, const unsigned char *rgb,
+		       const unsigned char *alpha, const unsigned char *paper,
+		       int n) {
+  if (alpha) {
+    convertScalar<pixelFormatRGB565>(dst, rgb, alpha, paper, n);
+  } else {
+    (*opaqueFuncs[pixelFormatRGB565])(dst, rgb, n);
+  }
+}
+
+static PixelConvertISA initPixelConvert(PixelConvertISA maxISA) {
+  PixelConvertISA isa;
+
+  isa = pixelConvertScalar;
+  opaqueFuncs[pixelFormatXRGB32] = &convertOpaqueScalar<pixelFormatXRGB32>;
+  opaqueFuncs[pixelFormatXBGR32] = &convertOpaqueScalar<pixelFormatXBGR32>;
+  opaqueFuncs[pixelFormatRGB565] = &convertOpaqueScalar<pixelFormatRGB565>;
+  blend32Func = &blend32Scalar;
+
+#ifdef PIXELCONVERT_X86
+  __builtin_cpu_init();
+  if (maxISA == pixelConvertScalar) {
+    return isa;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    blend32Func = &blend32SSE2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    opaqueFuncs[pixelFormatXRGB32] = &convert32SSSE3<pixelFormatXRGB32>;
+    opaqueFuncs[pixelFormatXBGR32] = &convert32SSSE3<pixelFormatXBGR32>;
+    opaqueFuncs[pixelFormatRGB565] = &convert565SSSE3;
+    isa = pixelConvertSSSE3;
+    if (maxISA >= pixelConvertAVX2 && __builtin_cpu_supports("avx2")) {
+      opaqueFuncs[pixelFormatXRGB32] = &convert32AVX2<pixelFormatXRGB32>;
+      opaqueFuncs[pixelFormatXBGR32] = &convert32AVX2<pixelFormatXBGR32>;
+      isa = pixelConvertAVX2;
+    }
+  }
+#endif
+  return isa;
+}
+
+PixelFormat getPixelFormat(int bitsPerPixel, unsigned long redMask,
+			   unsigned long greenMask, unsigned long blueMask) {
+  if (bitsPerPixel == 32 && greenMask == 0x00ff00) {
+    if (redMask == 0xff0000 && blueMask == 0x0000ff) {
+      return pixelFormatXRGB32;
+    }
+    if (redMask == 0x0000ff && blueMask == 0xff0000) {
+      return pixelFormatXBGR32;
+    }
+  } else if (bitsPerPixel == 16 && redMask == 0xf800 &&
+	     greenMask == 0x07e0 && blueMask == 0x001f) {
+    return pixelFormatRGB565;
+  }
+  return pixelFormatNone;
+}
+
+PixelConvertFunc getPixelConvertFunc(PixelFormat format) {
+  if (!blend32Func) {
+    initPixelConvert(pixelConvertAVX2);
+  }
+  switch (format) {
+  case pixelFormatXRGB32:
+    return &convert32<pixelFormatXRGB32>;
+  case pixelFormatXBGR32:
+    return &convert32<pixelFormatXBGR32>;
+  case pixelFormatRGB565:
+    return &convert565;
+  default:
+    return NULL;
+  }
+}
+
+PixelConvertISA setPixelConvertISA(PixelConvertISA isa) {
+  return initPixelConvert(isa);
+}
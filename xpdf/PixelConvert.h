@@ -0,0 +1,56 @@
+//========================================================================
+//
+// PixelConvert.h
+//
+// Fast conversion of RGB8 bitmap rows to TrueColor pixel formats.
+//
+//========================================================================
+
+#ifndef PIXELCONVERT_H
+#define PIXELCONVERT_H
+
+#include <poppler-config.h>
+
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Pixel formats with specialized converters.  The 32-bit formats are
+// named after the pixel value (from the most significant byte down),
+// and all formats are stored in the machine's native byte order.
+enum PixelFormat {
+  pixelFormatNone,		// anything else
+  pixelFormatXRGB32,		// 32 bits: 0x00RRGGBB
+  pixelFormatXBGR32,		// 32 bits: 0x00BBGGRR
+  pixelFormatRGB565		// 16 bits: rrrrrggg gggbbbbb
+};
+
+// Instruction sets the converters can use, from slowest to fastest.
+enum PixelConvertISA {
+  pixelConvertScalar,		// plain C++
+  pixelConvertSSSE3,		// SSE2 and SSSE3
+  pixelConvertAVX2		// SSE2, SSSE3, and AVX2
+};
+
+// Convert <n> RGB8 pixels from <rgb> to <dst>.  If <alpha> is
+// non-NULL, each pixel is first blended with <paper> (RGB8), using the
+// alpha values in <alpha>.
+typedef void (*PixelConvertFunc)(unsigned char *dst, const unsigned char *rgb,
+				 const unsigned char *alpha,
+				 const unsigned char *paper, int n);
+
+// Find the format with the given bits per pixel and channel masks.
+PixelFormat getPixelFormat(int bitsPerPixel, unsigned long redMask,
+			   unsigned long greenMask, unsigned long blueMask);
+
+// Return the fastest converter to <format> that this CPU supports, or
+// NULL for pixelFormatNone.
+PixelConvertFunc getPixelConvertFunc(PixelFormat format);
+
+// Limit all converters to <isa> (or the best instruction set this CPU
+// supports, if that's slower).  This is meant for testing and
+// benchmarking, and mustn't be called while a conversion is running.
+// Returns the instruction set that will actually be used.
+PixelConvertISA setPixelConvertISA(PixelConvertISA isa);
+
+#endif
@@ -0,0 +1,220 @@
+//========================================================================
+//
+// PixelConvertBench.cc
+//
+// Time the PixelConvert converters with each instruction set this CPU
+// supports, against the per-pixel XPutPixel() loop they replaced, and
+// check that they all produce the same pixels.
+//
+// Build with "make xpdf/PixelConvertBench".
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include "PixelConvert.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Pixels per row -- deliberately not a multiple of any vector width, so
+// the leftover pixels at the end of each row are timed too.
+#define benchRowSize 1999
+
+// Rows converted per timing run (about a 2000x2000 window).
+#define benchRows 2000
+
+// Timing runs per converter; the fastest one is reported.
+#define benchRuns 10
+
+struct BenchFormat {
+  PixelFormat format;
+  const char *name;
+  int depth, bpp;
+  unsigned long redMask, greenMask, blueMask;
+  int rDiv, gDiv, bDiv;		// as computed by XPDFCore::setupX()
+  int rShift, gShift, bShift;
+};
+
+static BenchFormat benchFormats[] = {
+  { pixelFormatXRGB32, "XRGB32", 24, 32, 0xff0000, 0x00ff00, 0x0000ff,
+    0, 0, 0, 16, 8, 0 },
+  { pixelFormatXBGR32, "XBGR32", 24, 32, 0x0000ff, 0x00ff00, 0xff0000,
+    0, 0, 0, 0, 8, 16 },
+  { pixelFormatRGB565, "RGB565", 16, 16, 0xf800, 0x07e0, 0x001f,
+    3, 2, 3, 11, 5, 0 }
+};
+
+static const char *isaNames[] = {
+  "scalar",
+  "SSSE3",
+  "AVX2"
+};
+
+//------------------------------------------------------------------------
+
+static inline int hostByteOrder() {
+  const unsigned short one = 1;
+
+  return *(const unsigned char *)&one ? LSBFirst : MSBFirst;
+}
+
+static inline unsigned char div255(int x) {
+  return (unsigned char)((x + (x >> 8) + 0x80) >> 8);
+}
+
+// The TrueColor loop from XPDFCore::updateTileData(), before the
+// converters were added.
+static void convertXPutPixel(BenchFormat *fmt, XImage *image,
+			     const unsigned char *rgb,
+			     const unsigned char *alpha,
+			     const unsigned char *paper) {
+  const unsigned char *p, *ap;
+  unsigned long pixel;
+  unsigned char a, a1;
+  int x, y, r, g, b;
+
+  for (y = 0; y < benchRows; ++y) {
+    p = rgb + y * benchRowSize * 3;
+    ap = alpha ? alpha + y * benchRowSize : NULL;
+    for (x = 0; x < benchRowSize; ++x) {
+      r = p[0];
+      g = p[1];
+      b = p[2];
+      if (ap) {
+	a = *ap++;
+	a1 = 255 - a;
+	r = div255(a1 * paper[0] + a * r);
+	g = div255(a1 * paper[1] + a * g);
+	b = div255(a1 * paper[2] + a * b);
+      }
+      r >>= fmt->rDiv;
+      g >>= fmt->gDiv;
+      b >>= fmt->bDiv;
+      pixel = ((unsigned long)r << fmt->rShift) +
+	      ((unsigned long)g << fmt->gShift) +
+	      ((unsigned long)b << fmt->bShift);
+      XPutPixel(image, x, y, pixel);
+      p += 3;
+    }
+  }
+}
+
+static double elapsed(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+				       t0).count();
+}
+
+static void printResult(BenchFormat *fmt, bool alpha, const char *name,
+			double t, double tBase, bool match) {
+  printf("%-6s %-6s %-9s %8.1f Mpixel/s  %6.2fx%s\n",
+	 fmt->name, alpha ? "alpha" : "opaque", name,
+	 ((double)benchRowSize * benchRows) / t / 1e6, tBase / t,
+	 match ? "" : "  MISMATCH");
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<unsigned char> rgb, alpha, dst;
+  std::vector<char> ref;
+  std::chrono::steady_clock::time_point t0;
+  unsigned char paper[3];
+  BenchFormat *fmt;
+  XImage image;
+  PixelConvertISA isa, maxISA;
+  PixelConvertFunc func;
+  int i, f, a, run, y;
+  double t, tBase, tBest;
+  bool ok, match;
+
+  // fixed pseudo-random data, so runs can be compared
+  srand(1);
+  rgb.resize((size_t)benchRowSize * benchRows * 3);
+  for (i = 0; i < (int)rgb.size(); ++i) {
+    rgb[i] = (unsigned char)(rand() & 0xff);
+  }
+  alpha.resize((size_t)benchRowSize * benchRows);
+  for (i = 0; i < (int)alpha.size(); ++i) {
+    alpha[i] = (unsigned char)(rand() & 0xff);
+  }
+  paper[0] = 0xff;
+  paper[1] = 0xf0;
+  paper[2] = 0xe0;
+
+  maxISA = setPixelConvertISA(pixelConvertAVX2);
+  printf("%d x %d pixels, best of %d runs; best instruction set: %s\n",
+	 benchRowSize, benchRows, benchRuns, isaNames[maxISA]);
+  printf("speedups are relative to the XPutPixel() loop\n");
+
+  ok = true;
+  for (f = 0; f < (int)(sizeof(benchFormats) / sizeof(BenchFormat)); ++f) {
+    fmt = &benchFormats[f];
+
+    // a client-side image in the host's byte order, like the ones
+    // XPDFCore converts into
+    memset(&image, 0, sizeof(image));
+    image.width = benchRowSize;
+    image.height = benchRows;
+    image.format = ZPixmap;
+    image.byte_order = hostByteOrder();
+    image.bitmap_unit = 32;
+    image.bitmap_bit_order = MSBFirst;
+    image.bitmap_pad = 32;
+    image.depth = fmt->depth;
+    image.bits_per_pixel = fmt->bpp;
+    image.red_mask = fmt->redMask;
+    image.green_mask = fmt->greenMask;
+    image.blue_mask = fmt->blueMask;
+    if (!XInitImage(&image)) {
+      fprintf(stderr, "XInitImage failed\n");
+      return 1;
+    }
+    ref.assign((size_t)image.bytes_per_line * benchRows, 0);
+    image.data = ref.data();
+    dst.assign(ref.size(), 0);
+
+    for (a = 0; a < 2; ++a) {
+      tBase = 0;
+      for (run = 0; run < benchRuns; ++run) {
+	t0 = std::chrono::steady_clock::now();
+	convertXPutPixel(fmt, &image, rgb.data(), a ? alpha.data() : NULL,
+			 paper);
+	t = elapsed(t0);
+	if (run == 0 || t < tBase) {
+	  tBase = t;
+	}
+      }
+      printResult(fmt, a, "XPutPixel", tBase, tBase, true);
+
+      for (i = pixelConvertScalar; i <= maxISA; ++i) {
+	isa = setPixelConvertISA((PixelConvertISA)i);
+	func = getPixelConvertFunc(fmt->format);
+	tBest = 0;
+	for (run = 0; run < benchRuns; ++run) {
+	  t0 = std::chrono::steady_clock::now();
+	  for (y = 0; y < benchRows; ++y) {
+	    (*func)(dst.data() + y * image.bytes_per_line,
+		    rgb.data() + y * benchRowSize * 3,
+		    a ? alpha.data() + y * benchRowSize : NULL,
+		    paper, benchRowSize);
+	  }
+	  t = elapsed(t0);
+	  if (run == 0 || t < tBest) {
+	    tBest = t;
+	  }
+	}
+	match = !memcmp(dst.data(), ref.data(), ref.size());
+	printResult(fmt, a, isaNames[isa], tBest, tBase, match);
+	ok = ok && match;
+      }
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+//========================================================================
+//
+// PixelDither.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include "PixelDither.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Threshold matrix: each value in [0, 63] appears once, and
+// consecutive values are spread as far apart as possible.
+static const unsigned char bayerMatrix[pixelDitherMatrixSize *
+				       pixelDitherMatrixSize] = {
+   0, 32,  8, 40,  2, 34, 10, 42,
+  48, 16, 56, 24, 50, 18, 58, 26,
+  12, 44,  4, 36, 14, 46,  6, 38,
+  60, 28, 52, 20, 62, 30, 54, 22,
+   3, 35, 11, 43,  1, 33,  9, 41,
+  51, 19, 59, 27, 49, 17, 57, 25,
+  15, 47,  7, 39, 13, 45,  5, 37,
+  63, 31, 55, 23, 61, 29, 53, 21
+};
+
+// Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
+static inline int div255(int x) {
+  return (x + (x >> 8) + 0x80) >> 8;
+}
+
+//------------------------------------------------------------------------
+// PixelDither
+//------------------------------------------------------------------------
+
+PixelDither::PixelDither(int cubeSizeA, const unsigned long *colorsA) {
+  int nLevels, t, v, level;
+
+  cubeSize = cubeSizeA;
+  if (cubeSize == 1) {
+    nLevels = 2;
+    colors.assign(colorsA, colorsA + 2);
+  } else {
+    nLevels = cubeSize;
+    colors.assign(colorsA, colorsA + cubeSize * cubeSize * cubeSize);
+  }
+
+  // a value that's a fraction f of the way from one level to the next
+  // goes to the next level where the threshold, (m + 0.5) / 64, is
+  // below f
+  for (t = 0; t < pixelDitherMatrixSize * pixelDitherMatrixSize; ++t) {
+    for (v = 0; v < 256; ++v) {
+      level = (v * (nLevels - 1) * 128 + (2 * bayerMatrix[t] + 1) * 255) /
+	      (255 * 128);
+      if (level > nLevels - 1) {
+	level = nLevels - 1;
+      }
+      levels[t][v] = (unsigned char)level;
+    }
+  }
+}
+
+void PixelDither::ditherRow(unsigned long *pixels, const unsigned char *rgb,
+			    const unsigned char *alpha,
+			    const unsigned char *paper,
+			    int x, int y, int n) {
+  const unsigned char (*row)[256];
+  const unsigned char *lev;
+  int i, r, g, b, a, a1;
+
+  row = levels + (y % pixelDitherMatrixSize) * pixelDitherMatrixSize;
+  for (i = 0; i < n; ++i) {
+    r = rgb[0];
+    g = rgb[1];
+    b = rgb[2];
+    rgb += 3;
+    if (alpha) {
+      a = *alpha++;
+      a1 = 255 - a;
+      r = div255(a1 * paper[0] + a * r);
+      g = div255(a1 * paper[1] + a * g);
+      b = div255(a1 * paper[2] + a * b);
+    }
+    lev = row[(x + i) % pixelDitherMatrixSize];
+    if (cubeSize == 1) {
+      // integer weights for 0.299, 0.587, 0.114, summing to 256
+      pixels[i] = colors[lev[(r * 77 + g * 151 + b * 28) >> 8]];
+    } else {
+      pixels[i] = colors[(lev[r] * cubeSize + lev[g]) * cubeSize + lev[b]];
+    }
+  }
+}
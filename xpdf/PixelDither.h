@@ -0,0 +1,58 @@
+//========================================================================
+//
+// PixelDither.h
+//
+// Ordered dithering of RGB8 bitmap rows to a color cube, or to black
+// and white.
+//
+//========================================================================
+
+#ifndef PIXELDITHER_H
+#define PIXELDITHER_H
+
+#include <poppler-config.h>
+
+#include <vector>
+#include "config.h"
+
+//------------------------------------------------------------------------
+
+// Width and height of the threshold matrix.
+#define pixelDitherMatrixSize 8
+
+//------------------------------------------------------------------------
+// PixelDither
+//------------------------------------------------------------------------
+
+// Each pixel is quantized against a threshold taken from a fixed 8x8
+// (Bayer) matrix, so a pixel's value depends only on its color and
+// position.  Unlike error diffusion, any part of a bitmap, or any of
+// its rows, can be dithered on its own, with no seams.
+class PixelDither {
+public:
+
+  // Set up for a <cubeSizeA> x <cubeSizeA> x <cubeSizeA> color cube,
+  // where <colorsA> holds the pixel value for ((r * cubeSizeA) + g) *
+  // cubeSizeA + b.  If <cubeSizeA> is 1, pixels are dithered to black
+  // (<colorsA>[0]) and white (<colorsA>[1]) instead.
+  PixelDither(int cubeSizeA, const unsigned long *colorsA);
+
+  // Dither <n> RGB8 pixels from <rgb> to pixel values in <pixels>.
+  // The pixels are at (<x>, <y>) and to its right, in a coordinate
+  // system shared by all the rows that end up next to each other.  If
+  // <alpha> is non-NULL, each pixel is first blended with <paper>
+  // (RGB8), using the alpha values in <alpha>.
+  void ditherRow(unsigned long *pixels, const unsigned char *rgb,
+		 const unsigned char *alpha, const unsigned char *paper,
+		 int x, int y, int n);
+
+private:
+
+  int cubeSize;
+  std::vector<unsigned long> colors;
+  unsigned char			// output level for each threshold and
+    levels[pixelDitherMatrixSize * pixelDitherMatrixSize][256];
+				//   component value
+};
+
+#endif
@@ -0,0 +1,573 @@
+//========================================================================
+//
+// TileRenderPool.cc
+//
+//========================================================================
+
+#include <poppler-config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <goo/GooString.h>
+#include <splash/SplashBitmap.h>
+#include "Error.h"
+#include "PDFDoc.h"
+#include "SplashOutputDev.h"
+#include "DiskTileCache.h"
+#include "MappedFileStream.h"
+#include "TileRenderPool.h"
+#include "config.h"
+
+//------------------------------------------------------------------------
+// TileRenderJob
+//------------------------------------------------------------------------
+
+TileRenderJob::TileRenderJob() {
+  id = 0;
+  docGen = 0;
+  page = 0;
+  dpi = 0;
+  rotate = 0;
+  x = y = w = h = 0;
+  reverseVideo = false;
+  prefetch = false;
+  cancelled = false;
+  ok = false;
+  bitmap = NULL;
+  parent = NULL;
+  bandIdx = 0;
+  nBandsLeft = 0;
+}
+
+TileRenderJob::~TileRenderJob() {
+  if (bitmap) {
+    delete bitmap;
+  }
+}
+
+//------------------------------------------------------------------------
+// TileRenderPool
+//------------------------------------------------------------------------
+
+// Bands are never made shorter than this.
+#define minBandHeight 256
+
+struct TileRenderPool::Worker {
+  std::thread thread;
+  std::unique_ptr<PDFDoc> doc;	// this worker's copy of the document
+  int docGen;			// generation of <doc>
+  std::unique_ptr<SplashOutputDev> out;
+};
+
+TileRenderPool::TileRenderPool(SplashColorMode colorModeA, int bitmapRowPadA,
+			       SplashColorPtr paperColorA, int nThreadsA,
+			       long long bandThresholdA,
+			       DiskTileCache *diskCacheA) {
+  colorMode = colorModeA;
+  bitmapRowPad = bitmapRowPadA;
+  splashColorCopy(paperColor, paperColorA);
+  nThreads = nThreadsA;
+  bandThreshold = bandThresholdA;
+  diskCache = diskCacheA;
+  nRunning = 0;
+  docGen = 0;
+  docFailed = false;
+  shutdown = false;
+
+  wakeupPipe[0] = wakeupPipe[1] = -1;
+  if (nThreads > 0) {
+    if (pipe(wakeupPipe) == 0) {
+      fcntl(wakeupPipe[0], F_SETFL, O_NONBLOCK);
+      fcntl(wakeupPipe[1], F_SETFL, O_NONBLOCK);
+      fcntl(wakeupPipe[0], F_SETFD, FD_CLOEXEC);
+      fcntl(wakeupPipe[1], F_SETFD, FD_CLOEXEC);
+    } else {
+      error(errInternal, -1, "Couldn't create render pool pipe - "
+	    "rendering in the foreground");
+      wakeupPipe[0] = wakeupPipe[1] = -1;
+      nThreads = 0;
+    }
+  }
+}
+
+TileRenderPool::~TileRenderPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    shutdown = true;
+    discardJobs();
+  }
+  cond.notify_all();
+  for (auto& worker: workers) {
+    worker->thread.join();
+  }
+  if (wakeupPipe[0] >= 0) {
+    close(wakeupPipe[0]);
+    close(wakeupPipe[1]);
+  }
+}
+
+void TileRenderPool::setDoc(const std::string& fileNameA,
+			    const std::string *ownerPasswordA,
+			    const std::string *userPasswordA,
+			    std::shared_ptr<MappedFile> mappedFileA) {
+  std::lock_guard<std::mutex> lock(mutex);
+  fileName = fileNameA;
+  mappedFile = mappedFileA;
+  ownerPassword.reset(ownerPasswordA ? new std::string(*ownerPasswordA)
+				     : NULL);
+  userPassword.reset(userPasswordA ? new std::string(*userPasswordA)
+				   : NULL);
+  ++docGen;
+  docFailed = false;
+  discardJobs();
+}
+
+void TileRenderPool::clearDoc() {
+  std::lock_guard<std::mutex> lock(mutex);
+  fileName.clear();
+  mappedFile.reset();
+  ownerPassword.reset();
+  userPassword.reset();
+  ++docGen;
+  docFailed = false;
+  discardJobs();
+}
+
+bool TileRenderPool::canRender() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return nThreads > 0 && !fileName.empty() && !docFailed;
+}
+
+void TileRenderPool::submit(std::unique_ptr<TileRenderJob> job) {
+  bool split;
+
+  // there's no point in splitting a job that will be read from the
+  // disk cache
+  split = bandThreshold > 0 && nThreads > 1 &&
+	  (long long)job->w * job->h >= bandThreshold &&
+	  (job->tileFile.empty() || access(job->tileFile.c_str(), R_OK));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (workers.empty()) {
+      startWorkers();
+    }
+    job->docGen = docGen;
+    if (split) {
+      splitJob(std::move(job));
+    } else {
+      enqueue(std::move(job));
+    }
+  }
+  cond.notify_all();
+}
+
+// Called with the mutex held.
+void TileRenderPool::enqueue(std::unique_ptr<TileRenderJob> job) {
+  if (job->prefetch) {
+    prefetchQueue.push_back(std::move(job));
+  } else {
+    queue.push_back(std::move(job));
+  }
+}
+
+// Split a job into one band per worker, so a single large tile can
+// use all the threads.  Called with the mutex held.
+void TileRenderPool::splitJob(std::unique_ptr<TileRenderJob> job) {
+  int nBands, bandH, i;
+
+  nBands = nThreads;
+  if (job->h / nBands < minBandHeight) {
+    nBands = job->h / minBandHeight;
+  }
+  if (nBands < 2) {
+    enqueue(std::move(job));
+    return;
+  }
+  bandH = (job->h + nBands - 1) / nBands;
+  job->ok = true;
+  job->nBandsLeft = nBands;
+  job->bands.resize(nBands);
+  for (i = 0; i < nBands; ++i) {
+    auto band = std::make_unique<TileRenderJob>();
+    band->id = job->id;
+    band->docGen = job->docGen;
+    band->page = job->page;
+    band->dpi = job->dpi;
+    band->rotate = job->rotate;
+    band->x = job->x;
+    band->y = job->y + i * bandH;
+    band->w = job->w;
+    band->h = bandH;
+    if (band->y + band->h > job->y + job->h) {
+      band->h = job->y + job->h - band->y;
+    }
+    band->reverseVideo = job->reverseVideo;
+    band->prefetch = job->prefetch;
+    band->parent = job.get();
+    band->bandIdx = i;
+    enqueue(std::move(band));
+  }
+  splitJobs.push_back(std::move(job));
+}
+
+// Throw away a job that hasn't been rendered.  Called with the mutex
+// held.
+void TileRenderPool::dropJob(std::unique_ptr<TileRenderJob> job) {
+  if (job->parent) {
+    job->cancelled = true;
+    bandDone(std::move(job));
+  }
+}
+
+// Hand a finished (or dropped) band back to its parent job.  Once
+// all of the bands are in, the parent is removed from splitJobs and
+// returned.  Called with the mutex held.
+std::unique_ptr<TileRenderJob> TileRenderPool::bandDone(
+				   std::unique_ptr<TileRenderJob> band) {
+  TileRenderJob *job;
+  std::unique_ptr<TileRenderJob> ret;
+
+  job = band->parent;
+  if (band->cancelled) {
+    job->cancelled = true;
+  }
+  if (!band->ok) {
+    job->ok = false;
+  }
+  job->bands[band->bandIdx] = std::move(band);
+  if (--job->nBandsLeft > 0) {
+    return ret;
+  }
+  for (auto it = splitJobs.begin(); it != splitJobs.end(); ++it) {
+    if (it->get() == job) {
+      ret = std::move(*it);
+      splitJobs.erase(it);
+      break;
+    }
+  }
+  return ret;
+}
+
+// Copy the bands of a split job into a single bitmap.
+void TileRenderPool::stitchBands(TileRenderJob *job) {
+  SplashBitmap *bitmap, *src;
+  int rowSize, alphaRowSize, y, sy;
+  bool alpha;
+
+  alpha = job->bands[0]->bitmap->getAlphaPtr() != NULL;
+  bitmap = new SplashBitmap(job->w, job->h, bitmapRowPad, colorMode, alpha);
+  for (auto& band: job->bands) {
+    src = band->bitmap;
+    rowSize = src->getRowSize();
+    if (rowSize > bitmap->getRowSize()) {
+      rowSize = bitmap->getRowSize();
+    }
+    alphaRowSize = src->getWidth();
+    if (alphaRowSize > job->w) {
+      alphaRowSize = job->w;
+    }
+    for (y = 0; y < band->h; ++y) {
+      // the slice can come back a row short due to rounding
+      sy = y < src->getHeight() ? y : src->getHeight() - 1;
+      memcpy(bitmap->getDataPtr() +
+	       (band->y - job->y + y) * bitmap->getRowSize(),
+	     src->getDataPtr() + sy * src->getRowSize(), rowSize);
+      if (alpha && src->getAlphaPtr()) {
+	memcpy(bitmap->getAlphaPtr() + (band->y - job->y + y) * job->w,
+	       src->getAlphaPtr() + sy * src->getWidth(), alphaRowSize);
+      }
+    }
+  }
+  job->bitmap = bitmap;
+  memcpy(job->ctm, job->bands[0]->ctm, 6 * sizeof(double));
+  memcpy(job->ictm, job->bands[0]->ictm, 6 * sizeof(double));
+  job->bands.clear();
+}
+
+void TileRenderPool::promote(long long id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = prefetchQueue.begin();
+  while (it != prefetchQueue.end()) {
+    if ((*it)->id == id) {
+      (*it)->prefetch = false;
+      queue.push_back(std::move(*it));
+      it = prefetchQueue.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void TileRenderPool::cancel(long long id) {
+  std::vector<std::unique_ptr<TileRenderJob>> dropped;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto *q: {&queue, &prefetchQueue}) {
+    auto it = q->begin();
+    while (it != q->end()) {
+      if ((*it)->id == id) {
+	dropped.push_back(std::move(*it));
+	it = q->erase(it);
+      } else {
+	++it;
+      }
+    }
+  }
+  for (auto& job: dropped) {
+    dropJob(std::move(job));
+  }
+  for (TileRenderJob *job: running) {
+    if (job->id == id) {
+      job->cancelled = true;
+    }
+  }
+  for (auto& job: splitJobs) {
+    if (job->id == id) {
+      job->cancelled = true;
+    }
+  }
+  for (auto it = done.begin(); it != done.end(); ++it) {
+    if ((*it)->id == id) {
+      done.erase(it);
+      break;
+    }
+  }
+}
+
+void TileRenderPool::cancelAll() {
+  std::lock_guard<std::mutex> lock(mutex);
+  discardJobs();
+}
+
+// Called with the mutex held.
+void TileRenderPool::discardJobs() {
+  std::vector<std::unique_ptr<TileRenderJob>> dropped;
+
+  for (auto& job: queue) {
+    dropped.push_back(std::move(job));
+  }
+  queue.clear();
+  for (auto& job: prefetchQueue) {
+    dropped.push_back(std::move(job));
+  }
+  prefetchQueue.clear();
+  for (auto& job: dropped) {
+    dropJob(std::move(job));
+  }
+  for (TileRenderJob *job: running) {
+    job->cancelled = true;
+  }
+  for (auto& job: splitJobs) {
+    job->cancelled = true;
+  }
+  done.clear();
+}
+
+void TileRenderPool::dropPrefetch(std::vector<long long>& ids) {
+  std::vector<std::unique_ptr<TileRenderJob>> dropped;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& job: prefetchQueue) {
+    ids.push_back(job->id);
+    dropped.push_back(std::move(job));
+  }
+  prefetchQueue.clear();
+  for (auto& job: dropped) {
+    dropJob(std::move(job));
+  }
+}
+
+bool TileRenderPool::takeDone(std::vector<std::unique_ptr<TileRenderJob>>&
+			        jobs) {
+  std::lock_guard<std::mutex> lock(mutex);
+  drainWakeup();
+  if (done.empty()) {
+    return false;
+  }
+  for (auto& job: done) {
+    jobs.push_back(std::move(job));
+  }
+  done.clear();
+  return true;
+}
+
+// Called with the mutex held.
+void TileRenderPool::startWorkers() {
+  for (int i = 0; i < nThreads; ++i) {
+    auto worker = std::make_unique<Worker>();
+    worker->docGen = -1;
+    worker->thread = std::thread(&TileRenderPool::workerLoop, this,
+				 worker.get());
+    workers.push_back(std::move(worker));
+  }
+}
+
+void TileRenderPool::workerLoop(Worker *worker) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  worker->out = std::make_unique<SplashOutputDev>(colorMode, bitmapRowPad,
+						  false, paperColor);
+
+  while (true) {
+    while (!shutdown && queue.empty() && prefetchQueue.empty()) {
+      cond.wait(lock);
+    }
+    if (shutdown) {
+      break;
+    }
+    std::unique_ptr<TileRenderJob> job;
+    if (!queue.empty()) {
+      job = std::move(queue.front());
+      queue.pop_front();
+    } else {
+      job = std::move(prefetchQueue.front());
+      prefetchQueue.pop_front();
+    }
+    if (job->docGen != docGen) {
+      dropJob(std::move(job));
+      continue;
+    }
+    ++nRunning;
+    running.push_back(job.get());
+
+    // (re)open the document if it has changed since this worker last
+    // rendered something
+    if (worker->docGen != job->docGen) {
+      std::string fileNameA = fileName;
+      std::shared_ptr<MappedFile> mappedFileA = mappedFile;
+      std::unique_ptr<std::string> ownerPasswordA, userPasswordA;
+      if (ownerPassword) {
+	ownerPasswordA = std::make_unique<std::string>(*ownerPassword);
+      }
+      if (userPassword) {
+	userPasswordA = std::make_unique<std::string>(*userPassword);
+      }
+      lock.unlock();
+      worker->out->startDoc(NULL);
+      worker->doc.reset();
+      auto ownerGS = makeGooStringPtr(ownerPasswordA.get());
+      auto userGS = makeGooStringPtr(userPasswordA.get());
+      std::unique_ptr<PDFDoc> newDoc;
+      if (mappedFileA) {
+	newDoc = std::make_unique<PDFDoc>(new MappedFileStream(mappedFileA),
+					  ownerGS.get(), userGS.get());
+      } else {
+	newDoc = std::make_unique<PDFDoc>(makeGooString(fileNameA),
+					  ownerGS.get(), userGS.get());
+      }
+      if (newDoc->isOk()) {
+	worker->doc = std::move(newDoc);
+	worker->out->startDoc(worker->doc.get());
+      }
+      worker->docGen = job->docGen;
+      lock.lock();
+      if (!worker->doc && job->docGen == docGen) {
+	docFailed = true;
+      }
+    }
+
+    if (worker->doc && !job->cancelled &&
+	!(job->parent && job->parent->cancelled)) {
+      lock.unlock();
+      if (!loadCachedJob(worker, job.get())) {
+	worker->out->setReverseVideo(job->reverseVideo);
+	worker->doc->displayPageSlice(worker->out.get(), job->page,
+				      job->dpi, job->dpi, job->rotate,
+				      false, true, false,
+				      job->x, job->y, job->w, job->h,
+				      &abortCheckCbk, job.get());
+	job->bitmap = worker->out->takeBitmap();
+	memcpy(job->ctm, worker->out->getDefCTM(), 6 * sizeof(double));
+	memcpy(job->ictm, worker->out->getDefICTM(), 6 * sizeof(double));
+	job->ok = true;
+	// bands are stored once they've been stitched together
+	if (!job->parent && !job->cancelled) {
+	  diskCache->store(job->tileFile, job->bitmap);
+	}
+      }
+      lock.lock();
+    }
+
+    --nRunning;
+    for (auto it = running.begin(); it != running.end(); ++it) {
+      if (*it == job.get()) {
+	running.erase(it);
+	break;
+      }
+    }
+    if (job->parent) {
+      std::unique_ptr<TileRenderJob> whole = bandDone(std::move(job));
+      if (!whole) {
+	continue;
+      }
+      job = std::move(whole);
+      if (job->ok && !job->cancelled) {
+	// nobody else can see the job now that it's out of splitJobs
+	lock.unlock();
+	stitchBands(job.get());
+	diskCache->store(job->tileFile, job->bitmap);
+	lock.lock();
+      }
+    }
+    if (job->docGen == docGen && !job->cancelled) {
+      done.push_back(std::move(job));
+      if (done.size() == 1) {
+	wakeup();
+      }
+    }
+  }
+
+  lock.unlock();
+  worker->out.reset();
+  worker->doc.reset();
+}
+
+// Try to fill in a job from the disk cache.  Returns true on success.
+bool TileRenderPool::loadCachedJob(Worker *worker, TileRenderJob *job) {
+  double *m, *mi;
+  double det;
+
+  if (!(job->bitmap = diskCache->load(job->tileFile))) {
+    return false;
+  }
+  m = job->ctm;
+  mi = job->ictm;
+  worker->doc->getCatalog()->getPage(job->page)->getDefaultCTM(
+				 m, job->dpi, job->dpi, job->rotate,
+				 false, worker->out->upsideDown());
+  m[4] -= job->x;
+  m[5] -= job->y;
+  det = 1 / (m[0] * m[3] - m[1] * m[2]);
+  mi[0] = m[3] * det;
+  mi[1] = -m[1] * det;
+  mi[2] = -m[2] * det;
+  mi[3] = m[0] * det;
+  mi[4] = (m[2] * m[5] - m[3] * m[4]) * det;
+  mi[5] = (m[1] * m[4] - m[0] * m[5]) * det;
+  job->ok = true;
+  return true;
+}
+
+AbortCheckBool TileRenderPool::abortCheckCbk(void *data) {
+  TileRenderJob *job = (TileRenderJob *)data;
+
+  return job->cancelled || (job->parent && job->parent->cancelled);
+}
+
+void TileRenderPool::wakeup() {
+  char c = 0;
+
+  if (wakeupPipe[1] >= 0) {
+    while (write(wakeupPipe[1], &c, 1) < 0 && errno == EINTR) ;
+  }
+}
+
+void TileRenderPool::drainWakeup() {
+  char buf[64];
+
+  if (wakeupPipe[0] >= 0) {
+    while (read(wakeupPipe[0], buf, sizeof(buf)) > 0) ;
+  }
+}
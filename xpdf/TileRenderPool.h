@@ -0,0 +1,189 @@
+//========================================================================
+//
+// TileRenderPool.h
+//
+// A pool of worker threads that rasterize tiles in the background.
+//
+//========================================================================
+
+#ifndef TILERENDERPOOL_H
+#define TILERENDERPOOL_H
+
+#include <poppler-config.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <splash/SplashTypes.h>
+#ifndef NO_GBOOL
+#include <goo/gtypes.h>
+#endif
+#include "config.h"
+
+// Return type of Poppler's abort check callbacks, which used GBool
+// until Poppler switched to bool.
+#ifdef NO_GBOOL
+typedef bool AbortCheckBool;
+#else
+typedef GBool AbortCheckBool;
+#endif
+
+class SplashBitmap;
+class DiskTileCache;
+class MappedFile;
+
+//------------------------------------------------------------------------
+// TileRenderJob
+//------------------------------------------------------------------------
+
+// A request to rasterize one slice of a page.  The job is owned by the
+// pool while it is queued or being rendered, and handed back to the
+// caller by TileRenderPool::takeDone().
+class TileRenderJob {
+public:
+
+  TileRenderJob();
+  ~TileRenderJob();
+
+  long long id;			// identifies the PDFCoreTile this is for
+  int docGen;			// document generation the job belongs to
+  int page;			// page number
+  double dpi;			// resolution
+  int rotate;			// rotation (not including the page's /Rotate)
+  int x, y, w, h;		// slice, in device space
+  bool reverseVideo;
+  bool prefetch;		// low priority: only rendered when there
+				//   are no other jobs waiting
+  std::string tileFile;		// disk cache file for the slice (empty if
+				//   the disk cache isn't in use)
+  std::atomic<bool> cancelled;	// set to abort the render
+
+  bool ok;			// set if the slice was rendered
+  SplashBitmap *bitmap;		// rendered slice (owned by the job)
+  double ctm[6];		// default CTM used for the slice
+  double ictm[6];		// inverse CTM
+
+  // Large jobs are split into horizontal bands, which are rendered
+  // as separate jobs (with the same id) and then stitched together.
+  TileRenderJob *parent;	// for a band: the job it is part of
+  int bandIdx;			// for a band: index in parent->bands
+  int nBandsLeft;		// for a split job: bands not yet finished
+  std::vector<std::unique_ptr<TileRenderJob>> bands;
+				// for a split job: finished bands
+};
+
+//------------------------------------------------------------------------
+// TileRenderPool
+//------------------------------------------------------------------------
+
+class TileRenderPool {
+public:
+
+  // Create a pool with <nThreadsA> workers.  If <nThreadsA> is zero,
+  // the pool is disabled and callers should render synchronously.
+  // Jobs covering at least <bandThresholdA> pixels are split into
+  // bands that are rendered in parallel (0 = never split).  Jobs with
+  // a tileFile are read from <diskCacheA> if possible, and written to
+  // it after rendering.
+  TileRenderPool(SplashColorMode colorModeA, int bitmapRowPadA,
+		 SplashColorPtr paperColorA, int nThreadsA,
+		 long long bandThresholdA, DiskTileCache *diskCacheA);
+  ~TileRenderPool();
+
+  // Set the document to be rendered.  Each worker opens its own copy
+  // of the file (Poppler documents can't be shared between threads) --
+  // through <mappedFileA>, if it's non-NULL, so the workers share the
+  // mapping.  Any queued jobs for the previous document are discarded.
+  void setDoc(const std::string& fileNameA,
+	      const std::string *ownerPasswordA,
+	      const std::string *userPasswordA,
+	      std::shared_ptr<MappedFile> mappedFileA = NULL);
+
+  // Forget the current document.
+  void clearDoc();
+
+  // Returns true if jobs can be submitted for the current document.
+  bool canRender();
+
+  // Returns the current document generation.
+  int getDocGen() { return docGen; }
+
+  // Queue a job.
+  void submit(std::unique_ptr<TileRenderJob> job);
+
+  // Raise a queued prefetch job to normal priority.
+  void promote(long long id);
+
+  // Discard all prefetch jobs that haven't started yet, appending
+  // their IDs to <ids>.
+  void dropPrefetch(std::vector<long long>& ids);
+
+  // Cancel a job.  If it's queued, it's removed; if it's being
+  // rendered, the render is aborted.  Either way, it will never be
+  // returned by takeDone().
+  void cancel(long long id);
+
+  // Cancel all jobs.
+  void cancelAll();
+
+  // Move all finished jobs into <jobs>.  Returns true if there were
+  // any.
+  bool takeDone(std::vector<std::unique_ptr<TileRenderJob>>& jobs);
+
+  // A file descriptor that becomes readable when a job finishes, for
+  // use in the caller's event loop; -1 if the pool is disabled.
+  int getWakeupFD() { return wakeupPipe[0]; }
+
+private:
+
+  struct Worker;
+
+  void startWorkers();
+  void enqueue(std::unique_ptr<TileRenderJob> job);
+  void splitJob(std::unique_ptr<TileRenderJob> job);
+  void dropJob(std::unique_ptr<TileRenderJob> job);
+  std::unique_ptr<TileRenderJob> bandDone(std::unique_ptr<TileRenderJob> band);
+  void stitchBands(TileRenderJob *job);
+  bool loadCachedJob(Worker *worker, TileRenderJob *job);
+  void discardJobs();
+  void workerLoop(Worker *worker);
+  static AbortCheckBool abortCheckCbk(void *data);
+  void wakeup();
+  void drainWakeup();
+
+  SplashColorMode colorMode;
+  int bitmapRowPad;
+  SplashColor paperColor;
+  int nThreads;
+  long long bandThreshold;
+  DiskTileCache *diskCache;
+
+  std::mutex mutex;		// protects everything below
+  std::condition_variable cond;	// signalled when a job is queued, or
+				//   on shutdown
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::deque<std::unique_ptr<TileRenderJob>> queue;
+  std::deque<std::unique_ptr<TileRenderJob>> prefetchQueue;
+  std::vector<TileRenderJob *> running;
+  std::vector<std::unique_ptr<TileRenderJob>> splitJobs;
+				// jobs waiting for their bands
+  std::vector<std::unique_ptr<TileRenderJob>> done;
+  int nRunning;			// number of jobs being rendered
+  std::string fileName;		// current document
+  std::shared_ptr<MappedFile> mappedFile;	// mapping of the current
+						//   document, if any
+  std::unique_ptr<std::string> ownerPassword;
+  std::unique_ptr<std::string> userPassword;
+  int docGen;			// incremented on every setDoc/clearDoc
+  bool docFailed;		// set if a worker couldn't open the doc
+  bool shutdown;
+
+  int wakeupPipe[2];
+};
+
+#endif
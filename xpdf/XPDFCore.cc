@@ -10,12 +10,25 @@
 
 #include <poppler-config.h>
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <X11/keysym.h>
 #include <X11/cursorfont.h>
+#ifdef HAVE_XSHM
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+#endif
+#include <iterator>
 #include <memory>
+#include <stdio.h>
 #include <string>
 #include <string.h>
 #include <utility>
+#include <vector>
 #include <goo/gmem.h>
 #include <goo/GooString.h>
 #include "gfile-xpdf.h"
@@ -30,6 +43,11 @@
 #include "CoreOutputDev.h"
 #include "PSOutputDev.h"
 #include "TextOutputDev.h"
+#include "DiskTileCache.h"
+#include "PDFSpool.h"
+#include "PixelConvert.h"
+#include "PixelDither.h"
+#include "TileRenderPool.h"
 #include <splash/SplashBitmap.h>
 #include <splash/SplashPattern.h>
 #include "XPDFApp.h"
@@ -47,6 +65,23 @@
 
 //------------------------------------------------------------------------
 
+// Largest scroll bar range handed to Motif -- longer documents are
+// scaled down to fit.
+#define maxScrollBarRange (1 << 24)
+
+// 2x2 checkerboard used to draw the selection on non-TrueColor
+// displays.
+static char selectStippleBits[] = { 0x01, 0x02 };
+
+//------------------------------------------------------------------------
+
+// Return the X byte order (LSBFirst or MSBFirst) of this machine.
+static inline int hostByteOrder() {
+  const unsigned short one = 1;
+
+  return *(const unsigned char *)&one ? LSBFirst : MSBFirst;
+}
+
 // Divide a 16-bit value (in [0, 255*255]) by 255, returning an 8-bit result.
 static inline unsigned char div255(int x) {
   return (unsigned char)((x + (x >> 8) + 0x80) >> 8);
@@ -61,28 +96,294 @@ Atom XPDFCore::textAtom;
 Atom XPDFCore::compoundtextAtom;
 Atom XPDFCore::utf8stringAtom;
 
+//------------------------------------------------------------------------
+// XImagePool
+//------------------------------------------------------------------------
+
+// Maximum amount of image data kept for reuse.
+#define xImagePoolMaxSize (64 * 1024 * 1024)
+
+// The pool is emptied once no images have been returned to it for this
+// long (in ms).
+#define xImagePoolTrimDelay 2000
+
+// Tile XImages (with their data) that have been finished with, kept
+// for reuse by new tiles of the same size, so that scrolling doesn't
+// allocate and free a tile's worth of memory for every tile.  Nearly
+// all tiles are the same size, so an exact match is almost always
+// available.  There is one pool, shared by all viewer windows.
+//
+// On a local display with the MIT-SHM extension, the image data is
+// kept in shared memory, so drawing an image doesn't copy its pixels
+// through the X connection.  The server reads shared memory images
+// after XShmPutImage returns, so their data must not be changed until
+// sync() has been called.
+class XImagePool {
+public:
+  XImagePool();
+  ~XImagePool();
+  XImage *get(Display *displayA, Visual *visual, unsigned int depth,
+	      int w, int h);
+  void put(XImage *image);
+  void draw(Drawable drawable, GC gc, XImage *image, int xSrc, int ySrc,
+	    int xDest, int yDest, int width, int height);
+  void sync();
+
+private:
+  static void trimCbk(XtPointer ptr, XtIntervalId *id);
+  static size_t imageSize(XImage *image)
+    { return (size_t)image->height * image->bytes_per_line; }
+  void destroyImage(XImage *image, bool detach);
+#ifdef HAVE_XSHM
+  static bool isShmImage(XImage *image) { return image->obdata != NULL; }
+  static int shmErrorHandler(Display *displayA, XErrorEvent *ev);
+  XImage *createShmImage(Visual *visual, unsigned int depth, int w, int h);
+#endif
+
+  std::vector<XImage *> images;	// unused images, oldest first
+  size_t size;			// total data size of <images>
+  Display *display;
+  XtAppContext appContext;
+  XtIntervalId trimID;
+#ifdef HAVE_XSHM
+  int shmState;			// -1 = not checked yet, 0 = no, 1 = yes
+  bool shmDrawPending;		// true if a shared memory image has been
+				//   drawn since the last sync()
+  static bool shmError;		// set by shmErrorHandler
+#endif
+};
+
+static XImagePool imagePool;
+
+#ifdef HAVE_XSHM
+bool XImagePool::shmError = false;
+#endif
+
+XImagePool::XImagePool() {
+  size = 0;
+  display = NULL;
+  appContext = NULL;
+  trimID = 0;
+#ifdef HAVE_XSHM
+  shmState = -1;
+  shmDrawPending = false;
+#endif
+}
+
+XImagePool::~XImagePool() {
+  // this runs at exit, when the display may already be closed -- the
+  // server drops its shared memory attachments when the connection
+  // closes
+  for (XImage *image: images) {
+    destroyImage(image, false);
+  }
+}
+
+XImage *XImagePool::get(Display *displayA, Visual *visual, unsigned int depth,
+			int w, int h) {
+  XImage *image;
+#ifdef HAVE_XSHM
+  const char *name;
+#endif
+
+  display = displayA;
+  appContext = XtDisplayToApplicationContext(display);
+  for (auto it = images.rbegin(); it != images.rend(); ++it) {
+    image = *it;
+    if (image->width == w && image->height == h &&
+	image->depth == (int)depth) {
+      images.erase(std::next(it).base());
+      size -= imageSize(image);
+      return image;
+    }
+  }
+
+#ifdef HAVE_XSHM
+  // shared memory only works if the server is on this machine
+  if (shmState < 0) {
+    name = DisplayString(display);
+    shmState = XShmQueryExtension(display) &&
+               (name[0] == ':' || !strncmp(name, "unix:", 5));
+  }
+  if (shmState && (image = createShmImage(visual, depth, w, h))) {
+    return image;
+  }
+#endif
+
+  image = XCreateImage(display, visual, depth, ZPixmap, 0, NULL, w, h, 8, 0);
+  image->data = (char *)gmallocn(h, image->bytes_per_line);
+  return image;
+}
+
+#ifdef HAVE_XSHM
+int XImagePool::shmErrorHandler(Display *displayA, XErrorEvent *ev) {
+  shmError = true;
+  return 0;
+}
+
+// Create an image in a new shared memory segment.  Returns NULL if
+// that fails, in which case shared memory isn't tried again if the
+// server refused to attach the segment.
+XImage *XImagePool::createShmImage(Visual *visual, unsigned int depth,
+				   int w, int h) {
+  XShmSegmentInfo *shmInfo;
+  XImage *image;
+  int (*oldHandler)(Display *, XErrorEvent *);
+
+  shmInfo = new XShmSegmentInfo();
+  image = XShmCreateImage(display, visual, depth, ZPixmap, NULL, shmInfo,
+			  w, h);
+  if (!image) {
+    delete shmInfo;
+    return NULL;
+  }
+  shmInfo->shmid = shmget(IPC_PRIVATE, imageSize(image), IPC_CREAT | 0600);
+  if (shmInfo->shmid < 0) {
+    XDestroyImage(image);
+    delete shmInfo;
+    return NULL;
+  }
+  shmInfo->shmaddr = image->data = (char *)shmat(shmInfo->shmid, NULL, 0);
+  if (shmInfo->shmaddr == (char *)-1) {
+    shmctl(shmInfo->shmid, IPC_RMID, NULL);
+    image->data = NULL;
+    XDestroyImage(image);
+    delete shmInfo;
+    return NULL;
+  }
+  shmInfo->readOnly = False;
+
+  // attach the segment in the server, and wait to see if that worked;
+  // once both sides are attached, the segment can be marked for
+  // deletion (it goes away when both detach)
+  shmError = false;
+  oldHandler = XSetErrorHandler(&shmErrorHandler);
+  XShmAttach(display, shmInfo);
+  XSync(display, False);
+  XSetErrorHandler(oldHandler);
+  shmctl(shmInfo->shmid, IPC_RMID, NULL);
+  if (shmError) {
+    shmState = 0;
+    shmdt(shmInfo->shmaddr);
+    image->data = NULL;
+    XDestroyImage(image);
+    delete shmInfo;
+    return NULL;
+  }
+  return image;
+}
+#endif
+
+void XImagePool::put(XImage *image) {
+  if (imageSize(image) > xImagePoolMaxSize) {
+    destroyImage(image, true);
+    return;
+  }
+  while (size + imageSize(image) > xImagePoolMaxSize) {
+    size -= imageSize(images.front());
+    destroyImage(images.front(), true);
+    images.erase(images.begin());
+  }
+  images.push_back(image);
+  size += imageSize(image);
+
+  if (appContext) {
+    if (trimID) {
+      XtRemoveTimeOut(trimID);
+    }
+    trimID = XtAppAddTimeOut(appContext, xImagePoolTrimDelay,
+			     &trimCbk, this);
+  }
+}
+
+// Draw part of an image, which must have come from get().
+void XImagePool::draw(Drawable drawable, GC gc, XImage *image,
+		      int xSrc, int ySrc, int xDest, int yDest,
+		      int width, int height) {
+#ifdef HAVE_XSHM
+  if (isShmImage(image)) {
+    XShmPutImage(display, drawable, gc, image, xSrc, ySrc, xDest, yDest,
+		 width, height, False);
+    shmDrawPending = true;
+    return;
+  }
+#endif
+  XPutImage(display, drawable, gc, image, xSrc, ySrc, xDest, yDest,
+	    width, height);
+}
+
+// Wait until the server has finished reading the images drawn so far.
+void XImagePool::sync() {
+#ifdef HAVE_XSHM
+  if (shmDrawPending) {
+    XSync(display, False);
+    shmDrawPending = false;
+  }
+#endif
+}
+
+void XImagePool::trimCbk(XtPointer ptr, XtIntervalId *id) {
+  XImagePool *pool = (XImagePool *)ptr;
+
+  pool->trimID = 0;
+  for (XImage *image: pool->images) {
+    pool->destroyImage(image, true);
+  }
+  pool->images.clear();
+  pool->size = 0;
+}
+
+// Free an image and its data.  If <detach> is true, the server's
+// attachment to a shared memory image is released too.
+void XImagePool::destroyImage(XImage *image, bool detach) {
+#ifdef HAVE_XSHM
+  XShmSegmentInfo *shmInfo;
+
+  if (isShmImage(image)) {
+    shmInfo = (XShmSegmentInfo *)image->obdata;
+    if (detach) {
+      XShmDetach(display, shmInfo);
+    }
+    shmdt(shmInfo->shmaddr);
+    image->data = NULL;
+    XDestroyImage(image);
+    delete shmInfo;
+    return;
+  }
+#endif
+  gfree(image->data);
+  image->data = NULL;
+  XDestroyImage(image);
+}
+
 //------------------------------------------------------------------------
 // XPDFCoreTile
 //------------------------------------------------------------------------
 
 class XPDFCoreTile: public PDFCoreTile {
 public:
-  XPDFCoreTile(int xDestA, int yDestA);
+  XPDFCoreTile(int xDestA, int yDestA, Display *displayA);
   virtual ~XPDFCoreTile();
+  Display *display;
   XImage *image;
+  Pixmap pixmap;		// copy of image on the server (with the
+				//   tilePixmaps option), or None
 };
 
-XPDFCoreTile::XPDFCoreTile(int xDestA, int yDestA):
+XPDFCoreTile::XPDFCoreTile(int xDestA, int yDestA, Display *displayA):
   PDFCoreTile(xDestA, yDestA)
 {
+  display = displayA;
   image = NULL;
+  pixmap = None;
 }
 
 XPDFCoreTile::~XPDFCoreTile() {
+  if (pixmap != None) {
+    XFreePixmap(display, pixmap);
+  }
   if (image) {
-    gfree(image->data);
-    image->data = NULL;
-    XDestroyImage(image);
+    imagePool.put(image);
   }
 }
 
@@ -94,7 +395,7 @@ XPDFCore::XPDFCore(Widget shellA, Widget parentWidgetA,
 		   SplashColorPtr paperColorA, unsigned long paperPixelA,
 		   unsigned long mattePixelA, bool fullScreenA, bool reverseVideoA,
 		   bool installCmap, int rgbCubeSizeA):
-  PDFCore(splashModeRGB8, 4, reverseVideoA, paperColorA)
+  PDFCore(getNativeColorMode(parentWidgetA), 4, reverseVideoA, paperColorA)
 {
   shell = shellA;
   parentWidget = parentWidgetA;
@@ -152,9 +453,39 @@ XPDFCore::XPDFCore(Widget shellA, Widget parentWidgetA,
   // do X-specific initialization and create the widgets
   initWindow();
   initPasswordDialog();
+
+  // listen for tiles finished by the render pool
+  renderInputID = 0;
+  if (renderPool->getWakeupFD() >= 0) {
+    renderInputID = XtAppAddInput(XtWidgetToApplicationContext(drawArea),
+				  renderPool->getWakeupFD(),
+				  (XtPointer)XtInputReadMask,
+				  &renderDoneCbk, this);
+  }
+  pageScanID = 0;
+  spoolInputID = 0;
+  damage = NULL;
+  damageID = 0;
+  vScrollScale = 1;
+  tilePixmaps = xpdfParams->getTilePixmaps();
+  nTileBitmapsReleased = nTileBitmapsKept = 0;
+  errorDiffusion = xpdfParams->getErrorDiffusion();
 }
 
 XPDFCore::~XPDFCore() {
+  if (renderInputID) {
+    XtRemoveInput(renderInputID);
+  }
+  if (pageScanID) {
+    XtRemoveWorkProc(pageScanID);
+  }
+  if (damageID) {
+    XtRemoveTimeOut(damageID);
+  }
+  if (damage) {
+    XDestroyRegion(damage);
+  }
+  stopSpool();
   if (currentSelectionOwner == this && currentSelection) {
     delete currentSelection;
     currentSelection = NULL;
@@ -163,6 +494,18 @@ XPDFCore::~XPDFCore() {
   if (drawAreaGC) {
     XFreeGC(display, drawAreaGC);
   }
+  if (selectGC) {
+    XFreeGC(display, selectGC);
+  }
+  if (selectStipple) {
+    XFreePixmap(display, selectStipple);
+  }
+  if (scrollGC) {
+    XFreeGC(display, scrollGC);
+  }
+  if (pixmapGC) {
+    XFreeGC(display, pixmapGC);
+  }
   if (scrolledWin) {
     XtDestroyWidget(scrolledWin);
   }
@@ -184,10 +527,27 @@ XPDFCore::~XPDFCore() {
 int XPDFCore::loadFile(const std::string& fileName,
 		       const std::string *ownerPassword,
 		       const std::string *userPassword) {
+  struct stat st;
   int err;
 
+  // pipes are copied into a spool file, which is loaded (more than
+  // once, if it's linearized) as the data arrives
+  if (fileName == "-") {
+    return loadSpool(dup(0), ownerPassword, userPassword);
+  }
+  if ((!spool || fileName != spool->getFileName()) &&
+      stat(fileName.c_str(), &st) == 0 && S_ISFIFO(st.st_mode)) {
+    return loadSpool(open(fileName.c_str(), O_RDONLY),
+		     ownerPassword, userPassword);
+  }
+
   err = PDFCore::loadFile(fileName, ownerPassword, userPassword);
   if (err == errNone) {
+    if (spool && fileName != spool->getFileName()) {
+      stopSpool();
+    }
+    startPageScan();
+
     // save the modification time
     modTime = xpdfGetModTime(doc->getFileName()->getCString());
 
@@ -206,6 +566,8 @@ int XPDFCore::loadFile(BaseStream *stream, const std::string *ownerPassword,
 
   err = PDFCore::loadFile(stream, ownerPassword, userPassword);
   if (err == errNone) {
+    startPageScan();
+
     // no file
     modTime = 0;
 
@@ -220,6 +582,7 @@ int XPDFCore::loadFile(BaseStream *stream, const std::string *ownerPassword,
 
 void XPDFCore::loadDoc(PDFDoc *docA) {
   PDFCore::loadDoc(docA);
+  startPageScan();
 
   // save the modification time
   if (doc->getFileName()) {
@@ -285,7 +648,7 @@ void XPDFCore::resizeToPage(int pg) {
   }
 }
 
-void XPDFCore::update(int topPageA, int scrollXA, int scrollYA,
+void XPDFCore::update(int topPageA, int scrollXA, long long scrollYA,
 		      double zoomA, int rotateA, bool force,
 		      bool addToHist, bool adjustScrollX) {
   int oldPage;
@@ -304,6 +667,11 @@ void XPDFCore::update(int topPageA, int scrollXA, int scrollYA,
 bool XPDFCore::checkForNewFile() {
   time_t newModTime;
 
+  // a spool file changes all the time -- spoolCbk decides when to
+  // reload it
+  if (spool) {
+    return false;
+  }
   if (doc->getFileName()) {
     newModTime = xpdfGetModTime(doc->getFileName()->getCString());
     if (newModTime != modTime) {
@@ -842,6 +1210,44 @@ void XPDFCore::takeFocus() {
 // GUI code
 //------------------------------------------------------------------------
 
+// Choose the Splash color mode to render in.  If the default visual's
+// pixels are laid out the same way as a Splash color mode, pages are
+// rendered in that mode, and the tiles only need to be copied into the
+// XImages; otherwise, pages are rendered in RGB8, and converted.
+SplashColorMode XPDFCore::getNativeColorMode(Widget widget) {
+  Display *dpy;
+  Visual *vis;
+  XPixmapFormatValues *formats;
+  int scr, dep, bpp, nFormats, i;
+
+  dpy = XtDisplay(widget);
+  scr = XScreenNumberOfScreen(XtScreen(widget));
+  vis = DefaultVisual(dpy, scr);
+  dep = DefaultDepth(dpy, scr);
+  if (vis->c_class != TrueColor) {
+    return splashModeRGB8;
+  }
+  bpp = 0;
+  if ((formats = XListPixmapFormats(dpy, &nFormats))) {
+    for (i = 0; i < nFormats; ++i) {
+      if (formats[i].depth == dep) {
+	bpp = formats[i].bits_per_pixel;
+	break;
+      }
+    }
+    XFree(formats);
+  }
+
+  // XBGR8 is stored as B,G,R,X bytes, which is a little-endian
+  // 0x00RRGGBB pixel
+  if (ImageByteOrder(dpy) == LSBFirst &&
+      getPixelFormat(bpp, vis->red_mask, vis->green_mask, vis->blue_mask)
+        == pixelFormatXRGB32) {
+    return splashModeXBGR8;
+  }
+  return splashModeRGB8;
+}
+
 void XPDFCore::setupX(bool installCmap, int rgbCubeSizeA) {
   XVisualInfo visualTempl;
   XVisualInfo *visualList;
@@ -1048,6 +1454,10 @@ void XPDFCore::initWindow() {
 
   // can't create a GC until the window gets mapped
   drawAreaGC = NULL;
+  selectGC = NULL;
+  selectStipple = None;
+  scrollGC = NULL;
+  pixmapGC = NULL;
 }
 
 void XPDFCore::hScrollChangeCbk(Widget widget, XtPointer ptr,
@@ -1071,7 +1481,8 @@ void XPDFCore::vScrollChangeCbk(Widget widget, XtPointer ptr,
   XPDFCore *core = (XPDFCore *)ptr;
   XmScrollBarCallbackStruct *data = (XmScrollBarCallbackStruct *)callData;
 
-  core->scrollTo(core->scrollX, data->value);
+  core->scrollTo(core->scrollX,
+		 (long long)(data->value * core->vScrollScale + 0.5));
 }
 
 void XPDFCore::vScrollDragCbk(Widget widget, XtPointer ptr,
@@ -1079,7 +1490,8 @@ void XPDFCore::vScrollDragCbk(Widget widget, XtPointer ptr,
   XPDFCore *core = (XPDFCore *)ptr;
   XmScrollBarCallbackStruct *data = (XmScrollBarCallbackStruct *)callData;
 
-  core->scrollTo(core->scrollX, data->value);
+  core->scrollTo(core->scrollX,
+		 (long long)(data->value * core->vScrollScale + 0.5));
 }
 
 void XPDFCore::resizeCbk(Widget widget, XtPointer ptr, XtPointer callData) {
@@ -1092,7 +1504,8 @@ void XPDFCore::resizeCbk(Widget widget, XtPointer ptr, XtPointer callData) {
   Arg args[2];
   int n;
   Dimension w, h;
-  int sx, sy;
+  long long sy;
+  int sx;
 
   // find the top-most widget which has an associated window, and look
   // for a pending ConfigureNotify in the event queue -- if there is
@@ -1150,6 +1563,7 @@ void XPDFCore::redrawCbk(Widget widget, XtPointer ptr, XtPointer callData) {
 void XPDFCore::inputCbk(Widget widget, XtPointer ptr, XtPointer callData) {
   XPDFCore *core = (XPDFCore *)ptr;
   XmDrawingAreaCallbackStruct *data = (XmDrawingAreaCallbackStruct *)callData;
+  XEvent event, next;
   LinkAction *action;
   int pg, x, y;
   double xu, yu;
@@ -1168,8 +1582,22 @@ void XPDFCore::inputCbk(Widget widget, XtPointer ptr, XtPointer callData) {
     }
     break;
   case MotionNotify:
+    // while panning or dragging out a selection, only the latest
+    // pointer position matters, so motion events that are already
+    // queued up behind this one are skipped
+    event = *data->event;
+    if (core->panning || core->dragging) {
+      while (XEventsQueued(core->display, QueuedAfterReading) > 0) {
+	XPeekEvent(core->display, &next);
+	if (next.type != MotionNotify ||
+	    next.xmotion.window != event.xmotion.window) {
+	  break;
+	}
+	XNextEvent(core->display, &event);
+      }
+    }
     if (core->doc && core->doc->getNumPages() > 0) {
-      ok = core->cvtWindowToDev(data->event->xmotion.x, data->event->xmotion.y,
+      ok = core->cvtWindowToDev(event.xmotion.x, event.xmotion.y,
 				&pg, &x, &y);
       if (core->dragging) {
 	if (ok) {
@@ -1226,10 +1654,10 @@ void XPDFCore::inputCbk(Widget widget, XtPointer ptr, XtPointer callData) {
       }
     }
     if (core->panning) {
-      core->scrollTo(core->scrollX - (data->event->xmotion.x - core->panMX),
-		     core->scrollY - (data->event->xmotion.y - core->panMY));
-      core->panMX = data->event->xmotion.x;
-      core->panMY = data->event->xmotion.y;
+      core->scrollTo(core->scrollX - (event.xmotion.x - core->panMX),
+		     core->scrollY - (event.xmotion.y - core->panMY));
+      core->panMX = event.xmotion.x;
+      core->panMY = event.xmotion.y;
     }
     break;
   case KeyPress:
@@ -1244,7 +1672,7 @@ void XPDFCore::inputCbk(Widget widget, XtPointer ptr, XtPointer callData) {
 }
 
 PDFCoreTile *XPDFCore::newTile(int xDestA, int yDestA) {
-  return new XPDFCoreTile(xDestA, yDestA);
+  return new XPDFCoreTile(xDestA, yDestA, display);
 }
 
 void XPDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
@@ -1252,10 +1680,12 @@ void XPDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
   XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
   XImage *image;
   SplashColorPtr dataPtr, p;
+  unsigned char *q;
+  PixelConvertFunc convert;
   unsigned long pixel;
   unsigned char *ap;
   unsigned char alpha, alpha1;
-  int w, h, bw, x, y, r, g, b, gray;
+  int w, h, bw, x, y, r, g, b;
   int *errDownR, *errDownG, *errDownB;
   int errRightR, errRightG, errRightB;
   int errDownRightR, errDownRightG, errDownRightB;
@@ -1264,49 +1694,70 @@ void XPDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
   if (!tile->image) {
     w = tile->xMax - tile->xMin;
     h = tile->yMax - tile->yMin;
-    image = XCreateImage(display, visual, depth, ZPixmap, 0, NULL, w, h, 8, 0);
-    image->data = (char *)gmallocn(h, image->bytes_per_line);
+    image = imagePool.get(display, visual, depth, w, h);
     tile->image = image;
   } else {
     image = (XImage *)tile->image;
   }
 
-  //~ optimize for known XImage formats
+  // the server may still be reading the image from shared memory
+  imagePool.sync();
+
   bw = tile->bitmap->getRowSize();
   dataPtr = tile->bitmap->getDataPtr();
 
-  if (trueColor) {
+  // if the page was rendered in the image's format, just copy it
+  if (colorMode == splashModeXBGR8) {
     for (y = 0; y < height; ++y) {
-      p = dataPtr + (ySrc + y) * bw + xSrc * 3;
+      p = dataPtr + (ySrc + y) * bw + xSrc * 4;
+      q = (unsigned char *)image->data + (ySrc + y) * image->bytes_per_line +
+	  xSrc * 4;
       if (!composited && tile->bitmap->getAlphaPtr()) {
 	ap = tile->bitmap->getAlphaPtr() +
 	       (ySrc + y) * tile->bitmap->getWidth() + xSrc;
-      } else {
-	ap = NULL;
-      }
-      for (x = 0; x < width; ++x) {
-	r = splashRGB8R(p);
-	g = splashRGB8G(p);
-	b = splashRGB8B(p);
-	if (ap) {
+	for (x = 0; x < width; ++x) {
 	  alpha = *ap++;
 	  alpha1 = 255 - alpha;
-	  r = div255(alpha1 * paperColor[0] + alpha * r);
-	  g = div255(alpha1 * paperColor[1] + alpha * g);
-	  b = div255(alpha1 * paperColor[2] + alpha * b);
+	  q[0] = div255(alpha1 * paperColor[2] + alpha * p[0]);
+	  q[1] = div255(alpha1 * paperColor[1] + alpha * p[1]);
+	  q[2] = div255(alpha1 * paperColor[0] + alpha * p[2]);
+	  q[3] = 255;
+	  p += 4;
+	  q += 4;
 	}
-	r >>= rDiv;
-	g >>= gDiv;
-	b >>= bDiv;
-	pixel = ((unsigned long)r << rShift) +
-	        ((unsigned long)g << gShift) +
-	        ((unsigned long)b << bShift);
-	XPutPixel(image, xSrc + x, ySrc + y, pixel);
-	p += 3;
+      } else {
+	memcpy(q, p, width * 4);
       }
     }
-  } else if (rgbCubeSize == 1) {
-    //~ this should really use splashModeMono, with non-clustered dithering
+    updateTilePixmap(tile, xSrc, ySrc, width, height);
+    return;
+  }
+
+  // common TrueColor formats are converted a row at a time, straight
+  // into the image data
+  convert = NULL;
+  if (trueColor && image->byte_order == hostByteOrder()) {
+    convert = getPixelConvertFunc(getPixelFormat(image->bits_per_pixel,
+						 image->red_mask,
+						 image->green_mask,
+						 image->blue_mask));
+  }
+
+  if (convert) {
+    for (y = 0; y < height; ++y) {
+      p = dataPtr + (ySrc + y) * bw + xSrc * 3;
+      if (!composited && tile->bitmap->getAlphaPtr()) {
+	ap = tile->bitmap->getAlphaPtr() +
+	       (ySrc + y) * tile->bitmap->getWidth() + xSrc;
+      } else {
+	ap = NULL;
+      }
+      (*convert)((unsigned char *)image->data +
+		   (ySrc + y) * image->bytes_per_line +
+		   xSrc * (image->bits_per_pixel >> 3),
+		 p, ap, paperColor, width);
+    }
+  } else if (trueColor) {
     for (y = 0; y < height; ++y) {
       p = dataPtr + (ySrc + y) * bw + xSrc * 3;
       if (!composited && tile->bitmap->getAlphaPtr()) {
@@ -1326,16 +1777,18 @@ void XPDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 	  g = div255(alpha1 * paperColor[1] + alpha * g);
 	  b = div255(alpha1 * paperColor[2] + alpha * b);
 	}
-	gray = (int)(0.299 * r + 0.587 * g + 0.114 * b + 0.5);
-	if (gray < 128) {
-	  pixel = colors[0];
-	} else {
-	  pixel = colors[1];
-	}
+	r >>= rDiv;
+	g >>= gDiv;
+	b >>= bDiv;
+	pixel = ((unsigned long)r << rShift) +
+	        ((unsigned long)g << gShift) +
+	        ((unsigned long)b << bShift);
 	XPutPixel(image, xSrc + x, ySrc + y, pixel);
 	p += 3;
       }
     }
+  } else if (rgbCubeSize == 1 || !errorDiffusion) {
+    ditherTileData(tile, xSrc, ySrc, width, height, composited);
   } else {
     // do Floyd-Steinberg dithering on the whole bitmap
     errDownR = (int *)gmallocn(width + 2, sizeof(int));
@@ -1413,6 +1866,379 @@ void XPDFCore::updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
     gfree(errDownG);
     gfree(errDownB);
   }
+
+  updateTilePixmap(tile, xSrc, ySrc, width, height);
+}
+
+// Dither part of a tile's bitmap into its image, with the ordered
+// dither.  This is a table lookup per pixel, so it's done right here
+// rather than handed off to other threads.
+void XPDFCore::ditherTileData(PDFCoreTile *tile, int xSrc, int ySrc,
+			      int width, int height, bool composited) {
+  XImage *image;
+  SplashBitmap *bitmap;
+  unsigned long *pixels;
+  unsigned char *ap, *q;
+  int x, y;
+
+  if (!dither) {
+    dither.reset(new PixelDither(rgbCubeSize, colors));
+  }
+
+  image = ((XPDFCoreTile *)tile)->image;
+  bitmap = tile->bitmap;
+  pixels = (unsigned long *)gmallocn(width, sizeof(unsigned long));
+  for (y = ySrc; y < ySrc + height; ++y) {
+    if (!composited && bitmap->getAlphaPtr()) {
+      ap = bitmap->getAlphaPtr() + y * bitmap->getWidth() + xSrc;
+    } else {
+      ap = NULL;
+    }
+    // the pattern is aligned to the page, so tiles meet seamlessly
+    dither->ditherRow(pixels,
+		      bitmap->getDataPtr() + y * bitmap->getRowSize() +
+		        xSrc * 3,
+		      ap, paperColor, tile->xMin + xSrc, tile->yMin + y,
+		      width);
+    if (image->bits_per_pixel == 8) {
+      q = (unsigned char *)image->data + y * image->bytes_per_line + xSrc;
+      for (x = 0; x < width; ++x) {
+	q[x] = (unsigned char)pixels[x];
+      }
+    } else {
+      for (x = 0; x < width; ++x) {
+	XPutPixel(image, xSrc + x, y, pixels[x]);
+      }
+    }
+  }
+  gfree(pixels);
+}
+
+// Copy a changed part of a tile's image to its pixmap, if it has one.
+void XPDFCore::updateTilePixmap(PDFCoreTile *tileA, int xSrc, int ySrc,
+				int width, int height) {
+  XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
+
+  if (tile->pixmap != None) {
+    imagePool.draw(tile->pixmap, pixmapGC, tile->image,
+		   xSrc, ySrc, xSrc, ySrc, width, height);
+  }
+}
+
+void XPDFCore::renderDoneCbk(XtPointer ptr, int *source, XtInputId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->finishTiles();
+}
+
+// Start reading a PDF file from a pipe.  This waits until enough of
+// the file has arrived to display it, and then reads the rest in the
+// background.
+int XPDFCore::loadSpool(int fd, const std::string *ownerPassword,
+			const std::string *userPassword) {
+  std::unique_ptr<PDFSpool> oldSpool;
+  int err;
+  bool more;
+
+  if (fd < 0) {
+    return errOpenFile;
+  }
+
+  // keep the old spool (if any) until its document has been replaced
+  if (spoolInputID) {
+    XtRemoveInput(spoolInputID);
+    spoolInputID = 0;
+  }
+  oldSpool = std::move(spool);
+  spool = std::make_unique<PDFSpool>(fd);
+
+  err = errOpenFile;
+  if (spool->isOk()) {
+    do {
+      more = spool->read();
+      if (spool->readyToOpen()) {
+	spool->setOpened();
+	err = loadFile(spool->getFileName(), ownerPassword, userPassword);
+      }
+    } while (err != errNone && more);
+  }
+  if (err != errNone) {
+    spool = std::move(oldSpool);
+  }
+  watchSpool();
+  return err;
+}
+
+// Read the rest of the spooled file as it arrives.
+void XPDFCore::watchSpool() {
+  int flags;
+
+  if (spool && !spool->isDone() && !spoolInputID) {
+    flags = fcntl(spool->getInputFD(), F_GETFL);
+    fcntl(spool->getInputFD(), F_SETFL, flags | O_NONBLOCK);
+    spoolInputID = XtAppAddInput(XtWidgetToApplicationContext(drawArea),
+				 spool->getInputFD(),
+				 (XtPointer)XtInputReadMask,
+				 &spoolCbk, this);
+  }
+}
+
+void XPDFCore::stopSpool() {
+  if (spoolInputID) {
+    XtRemoveInput(spoolInputID);
+    spoolInputID = 0;
+  }
+  spool.reset();
+}
+
+void XPDFCore::spoolCbk(XtPointer ptr, int *source, XtInputId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+  int pg;
+
+  core->spool->read();
+  if (core->spool->readyToOpen()) {
+    // stop watching the input while reloading, in case a password
+    // dialog runs the event loop
+    XtRemoveInput(core->spoolInputID);
+    core->spoolInputID = 0;
+
+    // reload with the data that has arrived so far, staying on the
+    // same page
+    pg = core->topPage;
+    core->spool->setOpened();
+    if (core->loadFile(core->spool->getFileName()) == errNone) {
+      if (pg > core->doc->getNumPages()) {
+	pg = core->doc->getNumPages();
+      }
+      core->displayPage(pg, core->zoom, core->rotate, false, false);
+    }
+  }
+  if (core->spool->isDone()) {
+    if (core->spoolInputID) {
+      XtRemoveInput(core->spoolInputID);
+      core->spoolInputID = 0;
+    }
+  } else {
+    core->watchSpool();
+  }
+}
+
+// Look up the sizes of a newly loaded document's pages in the
+// background, so the continuous mode layout is refined without holding
+// up the first page.
+void XPDFCore::startPageScan() {
+  if (!pageScanID) {
+    pageScanID = XtAppAddWorkProc(XtWidgetToApplicationContext(drawArea),
+				  &pageScanCbk, this);
+  }
+}
+
+Boolean XPDFCore::pageScanCbk(XtPointer ptr) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  if (core->scanPageSizes()) {
+    core->pageScanID = 0;
+    return True;
+  }
+  return False;
+}
+
+// In the native color mode, a finished tile's image holds exactly the
+// bitmap's pixels, so the bitmap is freed, and rebuilt from the image
+// if PDFCore needs it back (to move the tile into the tile cache).
+// The bitmap's alpha plane doesn't stop this: it's only used while
+// the tile is being rendered, and by now the pixels have been
+// composited with the paper.  In the RGB8 mode the conversion can
+// lose information, so both are kept.
+void XPDFCore::releaseTileBitmap(PDFCoreTile *tileA) {
+  XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
+
+  if (colorMode != splashModeXBGR8 || !tile->image ||
+      tile->bitmap->getWidth() < tile->image->width ||
+      tile->bitmap->getHeight() < tile->image->height) {
+    ++nTileBitmapsKept;
+  } else {
+    delete tile->bitmap;
+    tile->bitmap = NULL;
+    ++nTileBitmapsReleased;
+  }
+#ifdef DEBUG_TILE_BITMAPS
+  fprintf(stderr, "tile bitmaps: %ld released, %ld kept\n",
+	  nTileBitmapsReleased, nTileBitmapsKept);
+#endif
+}
+
+SplashBitmap *XPDFCore::restoreTileBitmap(PDFCoreTile *tileA) {
+  XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
+  SplashBitmap *bitmap;
+  XImage *image;
+  int y;
+
+  if (colorMode != splashModeXBGR8 || !tile->image) {
+    return NULL;
+  }
+  image = tile->image;
+  bitmap = new SplashBitmap(image->width, image->height, bitmapRowPad,
+			    colorMode, false);
+  for (y = 0; y < image->height; ++y) {
+    memcpy(bitmap->getDataPtr() + y * bitmap->getRowSize(),
+	   image->data + y * image->bytes_per_line, image->width * 4);
+  }
+  return bitmap;
+}
+
+void XPDFCore::drawSelection(int xDest, int yDest, int width, int height) {
+  Window drawAreaWin;
+  PDFCorePage *page;
+  SplashColor color;
+
+  drawAreaWin = XtWindow(drawArea);
+  initGCs();
+
+  color[0] = paperColor[0] ^ selectXorColor[0];
+  color[1] = paperColor[1] ^ selectXorColor[1];
+  color[2] = paperColor[2] ^ selectXorColor[2];
+  if (trueColor) {
+    // xor-ing with this turns the paper color into the selection color
+    XSetForeground(display, selectGC,
+		   findPixel(paperColor) ^ findPixel(color));
+  } else {
+    // line the stipple up with the selection, so it moves with it when
+    // the window is scrolled
+    XSetForeground(display, selectGC, findPixel(color));
+    if ((page = findPage(selectPage))) {
+      XSetTSOrigin(display, selectGC, page->xDest + selectULX,
+		   page->yDest + selectULY);
+    }
+  }
+  XFillRectangle(display, drawAreaWin, selectGC, xDest, yDest, width, height);
+}
+
+// Get the pixel value used for an RGB8 color.
+unsigned long XPDFCore::findPixel(SplashColorPtr rgb) {
+  int r, g, b, gray;
+
+  if (trueColor) {
+    return ((unsigned long)(rgb[0] >> rDiv) << rShift) +
+           ((unsigned long)(rgb[1] >> gDiv) << gShift) +
+           ((unsigned long)(rgb[2] >> bDiv) << bShift);
+  } else if (rgbCubeSize == 1) {
+    gray = (int)(0.299 * rgb[0] + 0.587 * rgb[1] + 0.114 * rgb[2] + 0.5);
+    return gray < 128 ? colors[0] : colors[1];
+  } else {
+    r = div255(rgb[0] * (rgbCubeSize - 1));
+    g = div255(rgb[1] * (rgbCubeSize - 1));
+    b = div255(rgb[2] * (rgbCubeSize - 1));
+    return colors[(r * rgbCubeSize + g) * rgbCubeSize + b];
+  }
+}
+
+// Create the GCs, once the window exists.
+void XPDFCore::initGCs() {
+  Window drawAreaWin;
+  XGCValues gcValues;
+
+  if (drawAreaGC) {
+    return;
+  }
+  drawAreaWin = XtWindow(drawArea);
+  gcValues.foreground = mattePixel;
+  gcValues.graphics_exposures = False;
+  drawAreaGC = XCreateGC(display, drawAreaWin,
+			 GCForeground | GCGraphicsExposures, &gcValues);
+  if (trueColor) {
+    gcValues.function = GXxor;
+    selectGC = XCreateGC(display, drawAreaWin, GCFunction, &gcValues);
+  } else {
+    // xor-ing colormap indexes would give unrelated colors, so the
+    // selection color is drawn over every other pixel instead
+    selectStipple = XCreateBitmapFromData(display, drawAreaWin,
+					  selectStippleBits, 2, 2);
+    gcValues.fill_style = FillStippled;
+    gcValues.stipple = selectStipple;
+    selectGC = XCreateGC(display, drawAreaWin,
+			 GCFillStyle | GCStipple, &gcValues);
+  }
+  gcValues.graphics_exposures = True;
+  scrollGC = XCreateGC(display, drawAreaWin, GCGraphicsExposures,
+		       &gcValues);
+  // (drawAreaGC and selectGC are clipped while the damage is redrawn,
+  // so tile pixmaps are filled through their own GC)
+  gcValues.graphics_exposures = False;
+  pixmapGC = XCreateGC(display, drawAreaWin, GCGraphicsExposures,
+		       &gcValues);
+}
+
+// Add a rectangle to the damaged part of the window.  Everything that
+// gets damaged while an event is being handled is redrawn at once,
+// clipped to the union of the rectangles, by a zero-length timeout,
+// i.e., on the next pass through the event loop.
+bool XPDFCore::addDamage(int x, int y, int width, int height) {
+  XRectangle rect;
+
+  // clip to the window before narrowing to XRectangle's 16-bit fields
+  // (the rectangle can be far off screen at high zoom)
+  if (x < 0) {
+    width += x;
+    x = 0;
+  }
+  if (y < 0) {
+    height += y;
+    y = 0;
+  }
+  if (x + width > drawAreaWidth) {
+    width = drawAreaWidth - x;
+  }
+  if (y + height > drawAreaHeight) {
+    height = drawAreaHeight - y;
+  }
+  if (!XtWindow(drawArea) || width <= 0 || height <= 0) {
+    return true;
+  }
+  if (!damage) {
+    damage = XCreateRegion();
+  }
+  rect.x = (short)x;
+  rect.y = (short)y;
+  rect.width = (unsigned short)width;
+  rect.height = (unsigned short)height;
+  XUnionRectWithRegion(&rect, damage, damage);
+  if (!damageID) {
+    damageID = XtAppAddTimeOut(XtWidgetToApplicationContext(drawArea), 0,
+			       &damageCbk, this);
+  }
+  return true;
+}
+
+void XPDFCore::damageCbk(XtPointer ptr, XtIntervalId *id) {
+  XPDFCore *core = (XPDFCore *)ptr;
+
+  core->damageID = 0;
+  core->flushDamage();
+}
+
+// Redraw the damaged part of the window.
+void XPDFCore::flushDamage() {
+  Region region;
+  XRectangle box;
+
+  if (!(region = damage)) {
+    return;
+  }
+  damage = NULL;
+  if (XEmptyRegion(region)) {
+    XDestroyRegion(region);
+    return;
+  }
+  initGCs();
+  XSetRegion(display, drawAreaGC, region);
+  XSetRegion(display, selectGC, region);
+  XClipBox(region, &box);
+  drawWindow(box.x, box.y, box.width, box.height, false);
+  XSetClipMask(display, drawAreaGC, None);
+  XSetClipMask(display, selectGC, None);
+  XDestroyRegion(region);
+  XFlush(display);
 }
 
 void XPDFCore::redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
@@ -1420,19 +2246,33 @@ void XPDFCore::redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 			  bool composited) {
   XPDFCoreTile *tile = (XPDFCoreTile *)tileA;
   Window drawAreaWin;
-  XGCValues gcValues;
 
-  // create a GC for the drawing area
   drawAreaWin = XtWindow(drawArea);
-  if (!drawAreaGC) {
-    gcValues.foreground = mattePixel;
-    drawAreaGC = XCreateGC(display, drawAreaWin, GCForeground, &gcValues);
+  initGCs();
+
+  // with the tilePixmaps option, a tile is sent to the server the
+  // first time it's drawn, and then copied from there
+  if (tile && tile->image && tilePixmaps && tile->pixmap == None) {
+    tile->pixmap = XCreatePixmap(display, drawAreaWin, tile->image->width,
+				 tile->image->height, depth);
+    imagePool.draw(tile->pixmap, pixmapGC, tile->image,
+		   0, 0, 0, 0, tile->image->width, tile->image->height);
   }
 
   // draw the document
-  if (tile && tile->image) {
-    XPutImage(display, drawAreaWin, drawAreaGC, tile->image,
-	      xSrc, ySrc, xDest, yDest, width, height);
+  if (tile && tile->pixmap != None) {
+    XCopyArea(display, tile->pixmap, drawAreaWin, drawAreaGC,
+	      xSrc, ySrc, width, height, xDest, yDest);
+  } else if (tile && tile->image) {
+    imagePool.draw(drawAreaWin, drawAreaGC, tile->image,
+		   xSrc, ySrc, xDest, yDest, width, height);
+
+  // draw blank paper for a tile that is still being rendered
+  } else if (tile) {
+    XSetForeground(display, drawAreaGC, paperPixel);
+    XFillRectangle(display, drawAreaWin, drawAreaGC,
+		   xDest, yDest, width, height);
+    XSetForeground(display, drawAreaGC, mattePixel);
 
   // draw the background
   } else {
@@ -1440,13 +2280,83 @@ void XPDFCore::redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 		   xDest, yDest, width, height);
   }
 
-  XFlush(display);
+  // anything else is flushed by the event loop, but a tile being
+  // rendered in the foreground is drawn bit by bit, without going back
+  // to the event loop
+  if (curTile) {
+    XFlush(display);
+  }
+}
+
+bool XPDFCore::scrollWindow(int dx, int dy) {
+  Window drawAreaWin;
+  XEvent event;
+  XRectangle rect;
+  Region window;
+
+  drawAreaWin = XtWindow(drawArea);
+  if (!drawAreaWin) {
+    return false;
+  }
+
+  // if part of the window is waiting to be redrawn, what's there now
+  // isn't worth moving
+  if (XCheckTypedWindowEvent(display, drawAreaWin, Expose, &event)) {
+    XPutBackEvent(display, &event);
+    return false;
+  }
+
+  // damage that hasn't been redrawn yet moves along with the window
+  // contents
+  if (damage) {
+    XOffsetRegion(damage, dx, dy);
+    rect.x = rect.y = 0;
+    rect.width = (unsigned short)drawAreaWidth;
+    rect.height = (unsigned short)drawAreaHeight;
+    window = XCreateRegion();
+    XUnionRectWithRegion(&rect, window, window);
+    XIntersectRegion(damage, window, damage);
+    XDestroyRegion(window);
+  }
+
+  initGCs();
+  XCopyArea(display, drawAreaWin, drawAreaWin, scrollGC,
+	    dx < 0 ? -dx : 0, dy < 0 ? -dy : 0,
+	    drawAreaWidth - abs(dx), drawAreaHeight - abs(dy),
+	    dx > 0 ? dx : 0, dy > 0 ? dy : 0);
+
+  // parts of the window that were covered (by other windows) couldn't
+  // be copied -- the server reports them with GraphicsExpose events,
+  // followed by a NoExpose if there were none; these are waited for
+  // here, since the next scroll would move them
+  while (true) {
+    XIfEvent(display, &event, &isGraphicsExpose, (XPointer)drawAreaWin);
+    if (event.type == NoExpose) {
+      break;
+    }
+    redrawWindow(event.xgraphicsexpose.x, event.xgraphicsexpose.y,
+		 event.xgraphicsexpose.width, event.xgraphicsexpose.height,
+		 false);
+    if (event.xgraphicsexpose.count == 0) {
+      break;
+    }
+  }
+  return true;
+}
+
+Bool XPDFCore::isGraphicsExpose(Display *displayA, XEvent *event,
+				XPointer arg) {
+  return (event->type == GraphicsExpose &&
+	  event->xgraphicsexpose.drawable == (Drawable)arg) ||
+         (event->type == NoExpose &&
+	  event->xnoexpose.drawable == (Drawable)arg);
 }
 
 void XPDFCore::updateScrollbars() {
   Arg args[20];
   int n;
-  int maxPos;
+  long long maxPosY;
+  int maxPos, value, slider, inc;
 
   if (!pages.empty()) {
     if (continuousMode) {
@@ -1470,22 +2380,45 @@ void XPDFCore::updateScrollbars() {
 
   if (!pages.empty()) {
     if (continuousMode) {
-      maxPos = totalDocH;
+      maxPosY = totalDocH;
     } else {
-      maxPos = pages.front()->h;
+      maxPosY = pages.front()->h;
     }
   } else {
-    maxPos = 1;
+    maxPosY = 1;
+  }
+  if (maxPosY < drawAreaHeight) {
+    maxPosY = drawAreaHeight;
+  }
+  // the scroll bar only handles int values, so continuous mode on a
+  // very long document maps several pixels to each scroll bar unit
+  if (maxPosY > maxScrollBarRange) {
+    vScrollScale = (double)maxPosY / maxScrollBarRange;
+  } else {
+    vScrollScale = 1;
+  }
+  maxPos = (int)(maxPosY / vScrollScale);
+  slider = (int)(drawAreaHeight / vScrollScale);
+  if (slider < 1) {
+    slider = 1;
+  }
+  inc = (int)(16 / vScrollScale);
+  if (inc < 1) {
+    inc = 1;
   }
-  if (maxPos < drawAreaHeight) {
-    maxPos = drawAreaHeight;
+  value = (int)(scrollY / vScrollScale + 0.5);
+  if (value > maxPos - slider) {
+    value = maxPos - slider;
+  }
+  if (value < 0) {
+    value = 0;
   }
   n = 0;
-  XtSetArg(args[n], XmNvalue, scrollY); ++n;
+  XtSetArg(args[n], XmNvalue, value); ++n;
   XtSetArg(args[n], XmNmaximum, maxPos); ++n;
-  XtSetArg(args[n], XmNsliderSize, drawAreaHeight); ++n;
-  XtSetArg(args[n], XmNincrement, 16); ++n;
-  XtSetArg(args[n], XmNpageIncrement, drawAreaHeight); ++n;
+  XtSetArg(args[n], XmNsliderSize, slider); ++n;
+  XtSetArg(args[n], XmNincrement, inc); ++n;
+  XtSetArg(args[n], XmNpageIncrement, slider); ++n;
   XtSetValues(vScrollBar, args, n);
 }
 
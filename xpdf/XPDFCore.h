@@ -23,6 +23,8 @@
 #include "config.h"
 
 class BaseStream;
+class PDFSpool;
+class PixelDither;
 class PDFDoc;
 class LinkAction;
 
@@ -62,7 +64,9 @@ public:
 
   //----- loadFile / displayPage / displayDest
 
-  // Load a new file.  Returns pdfOk or error code.
+  // Load a new file.  Returns pdfOk or error code.  A file name of
+  // "-" reads the file from stdin; that, or a named pipe, is displayed
+  // as soon as enough of it has arrived (see PDFSpool).
   virtual int loadFile(const std::string& fileName,
 		       const std::string *ownerPassword = NULL,
 		       const std::string *userPassword = NULL);
@@ -80,7 +84,7 @@ public:
   void resizeToPage(int pg);
 
   // Update the display, given the specified parameters.
-  virtual void update(int topPageA, int scrollXA, int scrollYA,
+  virtual void update(int topPageA, int scrollXA, long long scrollYA,
 		      double zoomA, int rotateA, bool force,
 		      bool addToHist, bool adjustScrollX);
 
@@ -158,6 +162,7 @@ private:
 				     int *format);
 
   //----- GUI code
+  static SplashColorMode getNativeColorMode(Widget widget);
   void setupX(bool installCmap, int rgbCubeSizeA);
   void initWindow();
   static void hScrollChangeCbk(Widget widget, XtPointer ptr,
@@ -171,12 +176,35 @@ private:
   static void resizeCbk(Widget widget, XtPointer ptr, XtPointer callData);
   static void redrawCbk(Widget widget, XtPointer ptr, XtPointer callData);
   static void inputCbk(Widget widget, XtPointer ptr, XtPointer callData);
+  static void renderDoneCbk(XtPointer ptr, int *source, XtInputId *id);
+  void startPageScan();
+  static Boolean pageScanCbk(XtPointer ptr);
+  int loadSpool(int fd, const std::string *ownerPassword,
+		const std::string *userPassword);
+  void watchSpool();
+  void stopSpool();
+  static void spoolCbk(XtPointer ptr, int *source, XtInputId *id);
   virtual PDFCoreTile *newTile(int xDestA, int yDestA);
   virtual void updateTileData(PDFCoreTile *tileA, int xSrc, int ySrc,
 			      int width, int height, bool composited);
+  void ditherTileData(PDFCoreTile *tile, int xSrc, int ySrc,
+		      int width, int height, bool composited);
+  void updateTilePixmap(PDFCoreTile *tileA, int xSrc, int ySrc,
+			int width, int height);
+  virtual void releaseTileBitmap(PDFCoreTile *tileA);
+  virtual SplashBitmap *restoreTileBitmap(PDFCoreTile *tileA);
+  virtual void drawSelection(int xDest, int yDest, int width, int height);
+  unsigned long findPixel(SplashColorPtr rgb);
+  void initGCs();
+  virtual bool addDamage(int x, int y, int width, int height);
+  static void damageCbk(XtPointer ptr, XtIntervalId *id);
+  void flushDamage();
   virtual void redrawRect(PDFCoreTile *tileA, int xSrc, int ySrc,
 			  int xDest, int yDest, int width, int height,
 			  bool composited);
+  virtual bool scrollWindow(int dx, int dy);
+  static Bool isGraphicsExpose(Display *displayA, XEvent *event,
+			       XPointer arg);
   virtual void updateScrollbars();
   void setCursor(Cursor cursor);
   bool doDialog(int type, bool hasCancel,
@@ -209,17 +237,37 @@ private:
   int rgbCubeSize;              // size of color cube (for non-TrueColor)
   unsigned long                 // color cube (for non-TrueColor)
     colors[xMaxRGBCube * xMaxRGBCube * xMaxRGBCube];
+  std::unique_ptr<PixelDither> dither;	// ordered dither (for
+					//   non-TrueColor)
+  bool errorDiffusion;		// use Floyd-Steinberg dithering instead
 
   Widget shell;			// top-level shell containing the widget
   Widget parentWidget;		// parent widget (not created by XPDFCore)
   Widget scrolledWin;
   Widget hScrollBar;
   Widget vScrollBar;
+  double vScrollScale;		// document pixels per vScrollBar unit
   Widget drawAreaFrame;
   Widget drawArea;
   Cursor busyCursor, linkCursor, selectCursor;
   Cursor currentCursor;
   GC drawAreaGC;		// GC for blitting into drawArea
+  GC selectGC;			// GC for drawing the selection (xor on
+				//   TrueColor, stippled otherwise)
+  Pixmap selectStipple;		// stipple for selectGC (non-TrueColor)
+  GC scrollGC;			// GC for scrolling the window contents
+  GC pixmapGC;			// GC for copying images to tile pixmaps
+  Region damage;		// parts of the window waiting to be
+				//   redrawn (NULL if none)
+  XtIntervalId damageID;	// redraws the damaged parts
+  bool tilePixmaps;		// keep tiles in server-side pixmaps
+  long nTileBitmapsReleased;	// finished tiles whose bitmaps were freed
+  long nTileBitmapsKept;	// finished tiles that kept their bitmaps
+				//   (printed with -DDEBUG_TILE_BITMAPS)
+  XtInputId renderInputID;	// watches the render pool's wakeup pipe
+  XtWorkProcId pageScanID;	// looks up page sizes while idle
+  std::unique_ptr<PDFSpool> spool;	// file being read from a pipe
+  XtInputId spoolInputID;	// watches the spool's input
 
   static GooString *currentSelection;  // selected text
   static XPDFCore *currentSelectionOwner;
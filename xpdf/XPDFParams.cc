@@ -14,6 +14,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <thread>
 #if HAVE_PAPER_H
 #include <paper.h>
 #endif
@@ -161,6 +162,20 @@ XPDFParams::XPDFParams(const char *cfgFileName) {
   psDuplex = false;
   initialZoom = "125";
   continuousView = false;
+  renderThreads = (int)std::thread::hardware_concurrency();
+  if (renderThreads < 1) {
+    renderThreads = 1;
+  } else if (renderThreads > 4) {
+    renderThreads = 4;
+  }
+  renderBandThreshold = 4;
+  prefetchPages = 2;
+  tileSize = 512;
+  tileCacheSize = 128;
+  diskCacheSize = 0;
+  tilePixmaps = false;
+  errorDiffusion = false;
+  mapFiles = false;
   createDefaultKeyBindings();
 
   // look for a user config file, then a system-wide config file
@@ -407,6 +422,33 @@ void XPDFParams::parseLine(const char *buf, const std::string& fileName,
     } else if (cmd == "continuousView") {
       parseYesNo("continuousView", xpdfParam(setContinuousView),
                  tokens, fileName, line);
+    } else if (cmd == "mapFiles") {
+      parseYesNo("mapFiles", xpdfParam(setMapFiles),
+                 tokens, fileName, line);
+    } else if (cmd == "renderThreads") {
+      parseInteger("renderThreads", xpdfParam(setRenderThreads),
+                   tokens, fileName, line);
+    } else if (cmd == "renderBandThreshold") {
+      parseFloat("renderBandThreshold", xpdfParam(setRenderBandThreshold),
+                 tokens, fileName, line);
+    } else if (cmd == "prefetchPages") {
+      parseInteger("prefetchPages", xpdfParam(setPrefetchPages),
+                   tokens, fileName, line);
+    } else if (cmd == "tileSize") {
+      parseInteger("tileSize", xpdfParam(setTileSize),
+                   tokens, fileName, line);
+    } else if (cmd == "tileCacheSize") {
+      parseInteger("tileCacheSize", xpdfParam(setTileCacheSize),
+                   tokens, fileName, line);
+    } else if (cmd == "diskCacheSize") {
+      parseInteger("diskCacheSize", xpdfParam(setDiskCacheSize),
+                   tokens, fileName, line);
+    } else if (cmd == "tilePixmaps") {
+      parseYesNo("tilePixmaps", xpdfParam(setTilePixmaps),
+                 tokens, fileName, line);
+    } else if (cmd == "errorDiffusion") {
+      parseYesNo("errorDiffusion", xpdfParam(setErrorDiffusion),
+                 tokens, fileName, line);
     } else if (cmd == "overprintPreview") {
       parseYesNo("overprintPreview", globalParam(setOverprintPreview),
                  tokens, fileName, line);
@@ -1001,6 +1043,87 @@ bool XPDFParams::getContinuousView() {
   return f;
 }
 
+bool XPDFParams::getMapFiles() {
+  bool f;
+
+  lockXPDFParams;
+  f = mapFiles;
+  unlockXPDFParams;
+  return f;
+}
+
+int XPDFParams::getRenderThreads() {
+  int n;
+
+  lockXPDFParams;
+  n = renderThreads;
+  unlockXPDFParams;
+  return n;
+}
+
+double XPDFParams::getRenderBandThreshold() {
+  double mp;
+
+  lockXPDFParams;
+  mp = renderBandThreshold;
+  unlockXPDFParams;
+  return mp;
+}
+
+int XPDFParams::getPrefetchPages() {
+  int n;
+
+  lockXPDFParams;
+  n = prefetchPages;
+  unlockXPDFParams;
+  return n;
+}
+
+int XPDFParams::getTileSize() {
+  int size;
+
+  lockXPDFParams;
+  size = tileSize;
+  unlockXPDFParams;
+  return size;
+}
+
+int XPDFParams::getTileCacheSize() {
+  int mb;
+
+  lockXPDFParams;
+  mb = tileCacheSize;
+  unlockXPDFParams;
+  return mb;
+}
+
+int XPDFParams::getDiskCacheSize() {
+  int mb;
+
+  lockXPDFParams;
+  mb = diskCacheSize;
+  unlockXPDFParams;
+  return mb;
+}
+
+bool XPDFParams::getTilePixmaps() {
+  bool f;
+
+  lockXPDFParams;
+  f = tilePixmaps;
+  unlockXPDFParams;
+  return f;
+}
+
+bool XPDFParams::getErrorDiffusion() {
+  bool f;
+
+  lockXPDFParams;
+  f = errorDiffusion;
+  unlockXPDFParams;
+  return f;
+}
+
 const StringList &XPDFParams::getKeyBinding(int code, int mods, int context) {
   int modMask;
 
@@ -1113,6 +1236,60 @@ void XPDFParams::setContinuousView(bool cont) {
   unlockXPDFParams;
 }
 
+void XPDFParams::setMapFiles(bool map) {
+  lockXPDFParams;
+  mapFiles = map;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setRenderThreads(int n) {
+  lockXPDFParams;
+  renderThreads = n < 0 ? 0 : n;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setRenderBandThreshold(double mp) {
+  lockXPDFParams;
+  renderBandThreshold = mp < 0 ? 0 : mp;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setPrefetchPages(int n) {
+  lockXPDFParams;
+  prefetchPages = n < 0 ? 0 : n;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setTileSize(int size) {
+  lockXPDFParams;
+  tileSize = size < 0 ? 0 : size;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setTileCacheSize(int mb) {
+  lockXPDFParams;
+  tileCacheSize = mb < 0 ? 0 : mb;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setDiskCacheSize(int mb) {
+  lockXPDFParams;
+  diskCacheSize = mb < 0 ? 0 : mb;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setTilePixmaps(bool pixmaps) {
+  lockXPDFParams;
+  tilePixmaps = pixmaps;
+  unlockXPDFParams;
+}
+
+void XPDFParams::setErrorDiffusion(bool diffusion) {
+  lockXPDFParams;
+  errorDiffusion = diffusion;
+  unlockXPDFParams;
+}
+
 void XPDFParams::setPageCommand(const std::string& cmd) {
   lockXPDFParams;
   pageCommand = cmd;
@@ -143,6 +143,15 @@ public:
   PSLevel getPSLevel();
   std::string getInitialZoom();
   bool getContinuousView();
+  bool getMapFiles();
+  int getRenderThreads();
+  double getRenderBandThreshold();
+  int getPrefetchPages();
+  int getTileSize();
+  int getTileCacheSize();
+  int getDiskCacheSize();
+  bool getTilePixmaps();
+  bool getErrorDiffusion();
   const std::string& getPageCommand() { return pageCommand; }
   const std::string& getLaunchCommand() { return launchCommand; }
   const std::string& getURLCommand() { return urlCommand; }
@@ -161,6 +170,15 @@ public:
   void setPSLevel(PSLevel level);
   void setInitialZoom(const std::string& s);
   void setContinuousView(bool cont);
+  void setMapFiles(bool map);
+  void setRenderThreads(int n);
+  void setRenderBandThreshold(double mp);
+  void setPrefetchPages(int n);
+  void setTileSize(int size);
+  void setTileCacheSize(int mb);
+  void setDiskCacheSize(int mb);
+  void setTilePixmaps(bool pixmaps);
+  void setErrorDiffusion(bool diffusion);
   void setPageCommand(const std::string& cmd);
 
 private:
@@ -224,6 +242,17 @@ private:
   PSLevel psLevel;		// PostScript level to generate
   std::string initialZoom;	// initial zoom level
   bool continuousView;		// continuous view mode
+  bool mapFiles;		// read PDF files with mmap()
+  int renderThreads;		// number of background rasterizer threads
+  double renderBandThreshold;	// split tiles this big (in megapixels)
+				//   into parallel bands
+  int prefetchPages;		// number of pages to render ahead
+  int tileSize;			// tile width and height, in pixels
+  int tileCacheSize;		// memory for off-screen tiles, in MB
+  int diskCacheSize;		// disk space for rendered tiles, in MB
+  bool tilePixmaps;		// keep displayed tiles in server pixmaps
+  bool errorDiffusion;		// dither with Floyd-Steinberg error
+				//   diffusion (instead of ordered)
   std::string pageCommand;	// command executed on page change
   std::string launchCommand;	// command executed for 'launch' links
   std::string urlCommand;	// command executed for URL links
@@ -164,86 +164,86 @@ static const int zoomHeightIdx = nZoomMenuItems -1;
 //------------------------------------------------------------------------
 
 XPDFViewerCmd XPDFViewer::cmdTab[] = {
-  { "about",                   0, false, false, &XPDFViewer::cmdAbout },
-  { "closeOutline",            0, false, false, &XPDFViewer::cmdCloseOutline },
-  { "closeWindow",             0, false, false, &XPDFViewer::cmdCloseWindow },
-  { "closeWindowOrQuit",       0, false, false, &XPDFViewer::cmdCloseWindowOrQuit },
-  { "continuousMode",          0, false, false, &XPDFViewer::cmdContinuousMode },
-  { "endPan",                  0, true,  true,  &XPDFViewer::cmdEndPan },
-  { "endSelection",            0, true,  true,  &XPDFViewer::cmdEndSelection },
-  { "find",                    0, true,  false, &XPDFViewer::cmdFind },
-  { "findNext",                0, true,  false, &XPDFViewer::cmdFindNext },
-  { "findPrev",                0, true,  false, &XPDFViewer::cmdFindPrev },
-  { "focusToDocWin",           0, false, false, &XPDFViewer::cmdFocusToDocWin },
-  { "focusToPageNum",          0, false, false, &XPDFViewer::cmdFocusToPageNum },
-  { "focusToZoom",             0, false, false, &XPDFViewer::cmdFocusToZoom },
-  { "followLink",              0, true,  true,  &XPDFViewer::cmdFollowLink },
-  { "followLinkInNewWin",      0, true,  true,  &XPDFViewer::cmdFollowLinkInNewWin },
-  { "followLinkInNewWinNoSel", 0, true,  true,  &XPDFViewer::cmdFollowLinkInNewWinNoSel },
-  { "followLinkNoSel",         0, true,  true,  &XPDFViewer::cmdFollowLinkNoSel },
-  { "fullScreenMode",          0, false, false, &XPDFViewer::cmdFullScreenMode },
-  { "goBackward",              0, false, false, &XPDFViewer::cmdGoBackward },
-  { "goForward",               0, false, false, &XPDFViewer::cmdGoForward },
-  { "gotoDest",                1, true,  false, &XPDFViewer::cmdGotoDest },
-  { "gotoLastPage",            0, true,  false, &XPDFViewer::cmdGotoLastPage },
-  { "gotoLastPageNoScroll",    0, true,  false, &XPDFViewer::cmdGotoLastPageNoScroll },
-  { "gotoPage",                1, true,  false, &XPDFViewer::cmdGotoPage },
-  { "gotoPageNoScroll",        1, true,  false, &XPDFViewer::cmdGotoPageNoScroll },
-  { "nextPage",                0, true,  false, &XPDFViewer::cmdNextPage },
-  { "nextPageNoScroll",        0, true,  false, &XPDFViewer::cmdNextPageNoScroll },
-  { "open",                    0, false, false, &XPDFViewer::cmdOpen },
-  { "openFile",                1, false, false, &XPDFViewer::cmdOpenFile },
-  { "openFileAtDest",          2, false, false, &XPDFViewer::cmdOpenFileAtDest },
-  { "openFileAtDestInNewWin",  2, false, false, &XPDFViewer::cmdOpenFileAtDestInNewWin },
-  { "openFileAtPage",          2, false, false, &XPDFViewer::cmdOpenFileAtPage },
-  { "openFileAtPageInNewWin",  2, false, false, &XPDFViewer::cmdOpenFileAtPageInNewWin },
-  { "openFileInNewWin",        1, false, false, &XPDFViewer::cmdOpenFileInNewWin },
-  { "openInNewWin",            0, false, false, &XPDFViewer::cmdOpenInNewWin },
-  { "openOutline",             0, false, false, &XPDFViewer::cmdOpenOutline },
-  { "pageDown",                0, true,  false, &XPDFViewer::cmdPageDown },
-  { "pageUp",                  0, true,  false, &XPDFViewer::cmdPageUp },
-  { "postPopupMenu",           0, false, true,  &XPDFViewer::cmdPostPopupMenu },
-  { "prevPage",                0, true,  false, &XPDFViewer::cmdPrevPage },
-  { "prevPageNoScroll",        0, true,  false, &XPDFViewer::cmdPrevPageNoScroll },
-  { "print",                   0, true,  false, &XPDFViewer::cmdPrint },
-  { "quit",                    0, false, false, &XPDFViewer::cmdQuit },
-  { "raise",                   0, false, false, &XPDFViewer::cmdRaise },
-  { "redraw",                  0, true,  false, &XPDFViewer::cmdRedraw },
-  { "reload",                  0, true,  false, &XPDFViewer::cmdReload },
-  { "rotateCCW",               0, true,  false, &XPDFViewer::cmdRotateCCW },
-  { "rotateCW",                0, true,  false, &XPDFViewer::cmdRotateCW },
-  { "run",                     1, false, false, &XPDFViewer::cmdRun },
-  { "saveAs",                  0, true,  false, &XPDFViewer::cmdSaveAs },
-  { "scrollDown",              1, true,  false, &XPDFViewer::cmdScrollDown },
-  { "scrollDownNextPage",      1, true,  false, &XPDFViewer::cmdScrollDownNextPage },
-  { "scrollLeft",              1, true,  false, &XPDFViewer::cmdScrollLeft },
-  { "scrollOutlineDown",       1, true,  false, &XPDFViewer::cmdScrollOutlineDown },
-  { "scrollOutlineUp",         1, true,  false, &XPDFViewer::cmdScrollOutlineUp },
-  { "scrollRight",             1, true,  false, &XPDFViewer::cmdScrollRight },
-  { "scrollToBottomEdge",      0, true,  false, &XPDFViewer::cmdScrollToBottomEdge },
-  { "scrollToBottomRight",     0, true,  false, &XPDFViewer::cmdScrollToBottomRight },
-  { "scrollToLeftEdge",        0, true,  false, &XPDFViewer::cmdScrollToLeftEdge },
-  { "scrollToRightEdge",       0, true,  false, &XPDFViewer::cmdScrollToRightEdge },
-  { "scrollToTopEdge",         0, true,  false, &XPDFViewer::cmdScrollToTopEdge },
-  { "scrollToTopLeft",         0, true,  false, &XPDFViewer::cmdScrollToTopLeft },
-  { "scrollUp",                1, true,  false, &XPDFViewer::cmdScrollUp },
-  { "scrollUpPrevPage",        1, true,  false, &XPDFViewer::cmdScrollUpPrevPage },
-  { "search",                  1, true,  false, &XPDFViewer::cmdSearch },
-  { "setSelection",            5, true,  false, &XPDFViewer::cmdSetSelection },
-  { "singlePageMode",          0, false, false, &XPDFViewer::cmdSinglePageMode },
-  { "startPan",                0, true,  true,  &XPDFViewer::cmdStartPan },
-  { "startSelection",          0, true,  true,  &XPDFViewer::cmdStartSelection },
-  { "toggleContinuousMode",    0, false, false, &XPDFViewer::cmdToggleContinuousMode },
-  { "toggleFullScreenMode",    0, false, false, &XPDFViewer::cmdToggleFullScreenMode },
-  { "toggleOutline",           0, false, false, &XPDFViewer::cmdToggleOutline },
-  { "windowMode",              0, false, false, &XPDFViewer::cmdWindowMode },
-  { "zoomFitHeight",           0, false, false, &XPDFViewer::cmdZoomFitHeight },
-  { "zoomFitPage",             0, false, false, &XPDFViewer::cmdZoomFitPage },
-  { "zoomFitWidth",            0, false, false, &XPDFViewer::cmdZoomFitWidth },
-  { "zoomIn",                  0, false, false, &XPDFViewer::cmdZoomIn },
-  { "zoomOut",                 0, false, false, &XPDFViewer::cmdZoomOut },
-  { "zoomPercent",             1, false, false, &XPDFViewer::cmdZoomPercent },
-  { "zoomToSelection",         0, true,  false, &XPDFViewer::cmdZoomToSelection }
+  { "about",                   0, false, false, false, &XPDFViewer::cmdAbout },
+  { "closeOutline",            0, false, false, false, &XPDFViewer::cmdCloseOutline },
+  { "closeWindow",             0, false, false, false, &XPDFViewer::cmdCloseWindow },
+  { "closeWindowOrQuit",       0, false, false, false, &XPDFViewer::cmdCloseWindowOrQuit },
+  { "continuousMode",          0, false, false, false, &XPDFViewer::cmdContinuousMode },
+  { "endPan",                  0, true,  true,  false, &XPDFViewer::cmdEndPan },
+  { "endSelection",            0, true,  true,  false, &XPDFViewer::cmdEndSelection },
+  { "find",                    0, true,  false, false, &XPDFViewer::cmdFind },
+  { "findNext",                0, true,  false, false, &XPDFViewer::cmdFindNext },
+  { "findPrev",                0, true,  false, false, &XPDFViewer::cmdFindPrev },
+  { "focusToDocWin",           0, false, false, false, &XPDFViewer::cmdFocusToDocWin },
+  { "focusToPageNum",          0, false, false, false, &XPDFViewer::cmdFocusToPageNum },
+  { "focusToZoom",             0, false, false, false, &XPDFViewer::cmdFocusToZoom },
+  { "followLink",              0, true,  true,  false, &XPDFViewer::cmdFollowLink },
+  { "followLinkInNewWin",      0, true,  true,  false, &XPDFViewer::cmdFollowLinkInNewWin },
+  { "followLinkInNewWinNoSel", 0, true,  true,  false, &XPDFViewer::cmdFollowLinkInNewWinNoSel },
+  { "followLinkNoSel",         0, true,  true,  false, &XPDFViewer::cmdFollowLinkNoSel },
+  { "fullScreenMode",          0, false, false, false, &XPDFViewer::cmdFullScreenMode },
+  { "goBackward",              0, false, false, false, &XPDFViewer::cmdGoBackward },
+  { "goForward",               0, false, false, false, &XPDFViewer::cmdGoForward },
+  { "gotoDest",                1, true,  false, false, &XPDFViewer::cmdGotoDest },
+  { "gotoLastPage",            0, true,  false, false, &XPDFViewer::cmdGotoLastPage },
+  { "gotoLastPageNoScroll",    0, true,  false, false, &XPDFViewer::cmdGotoLastPageNoScroll },
+  { "gotoPage",                1, true,  false, false, &XPDFViewer::cmdGotoPage },
+  { "gotoPageNoScroll",        1, true,  false, false, &XPDFViewer::cmdGotoPageNoScroll },
+  { "nextPage",                0, true,  false, true,  &XPDFViewer::cmdNextPage },
+  { "nextPageNoScroll",        0, true,  false, true,  &XPDFViewer::cmdNextPageNoScroll },
+  { "open",                    0, false, false, false, &XPDFViewer::cmdOpen },
+  { "openFile",                1, false, false, false, &XPDFViewer::cmdOpenFile },
+  { "openFileAtDest",          2, false, false, false, &XPDFViewer::cmdOpenFileAtDest },
+  { "openFileAtDestInNewWin",  2, false, false, false, &XPDFViewer::cmdOpenFileAtDestInNewWin },
+  { "openFileAtPage",          2, false, false, false, &XPDFViewer::cmdOpenFileAtPage },
+  { "openFileAtPageInNewWin",  2, false, false, false, &XPDFViewer::cmdOpenFileAtPageInNewWin },
+  { "openFileInNewWin",        1, false, false, false, &XPDFViewer::cmdOpenFileInNewWin },
+  { "openInNewWin",            0, false, false, false, &XPDFViewer::cmdOpenInNewWin },
+  { "openOutline",             0, false, false, false, &XPDFViewer::cmdOpenOutline },
+  { "pageDown",                0, true,  false, false, &XPDFViewer::cmdPageDown },
+  { "pageUp",                  0, true,  false, false, &XPDFViewer::cmdPageUp },
+  { "postPopupMenu",           0, false, true,  false, &XPDFViewer::cmdPostPopupMenu },
+  { "prevPage",                0, true,  false, true,  &XPDFViewer::cmdPrevPage },
+  { "prevPageNoScroll",        0, true,  false, true,  &XPDFViewer::cmdPrevPageNoScroll },
+  { "print",                   0, true,  false, false, &XPDFViewer::cmdPrint },
+  { "quit",                    0, false, false, false, &XPDFViewer::cmdQuit },
+  { "raise",                   0, false, false, false, &XPDFViewer::cmdRaise },
+  { "redraw",                  0, true,  false, false, &XPDFViewer::cmdRedraw },
+  { "reload",                  0, true,  false, false, &XPDFViewer::cmdReload },
+  { "rotateCCW",               0, true,  false, false, &XPDFViewer::cmdRotateCCW },
+  { "rotateCW",                0, true,  false, false, &XPDFViewer::cmdRotateCW },
+  { "run",                     1, false, false, false, &XPDFViewer::cmdRun },
+  { "saveAs",                  0, true,  false, false, &XPDFViewer::cmdSaveAs },
+  { "scrollDown",              1, true,  false, true,  &XPDFViewer::cmdScrollDown },
+  { "scrollDownNextPage",      1, true,  false, false, &XPDFViewer::cmdScrollDownNextPage },
+  { "scrollLeft",              1, true,  false, true,  &XPDFViewer::cmdScrollLeft },
+  { "scrollOutlineDown",       1, true,  false, false, &XPDFViewer::cmdScrollOutlineDown },
+  { "scrollOutlineUp",         1, true,  false, false, &XPDFViewer::cmdScrollOutlineUp },
+  { "scrollRight",             1, true,  false, true,  &XPDFViewer::cmdScrollRight },
+  { "scrollToBottomEdge",      0, true,  false, false, &XPDFViewer::cmdScrollToBottomEdge },
+  { "scrollToBottomRight",     0, true,  false, false, &XPDFViewer::cmdScrollToBottomRight },
+  { "scrollToLeftEdge",        0, true,  false, false, &XPDFViewer::cmdScrollToLeftEdge },
+  { "scrollToRightEdge",       0, true,  false, false, &XPDFViewer::cmdScrollToRightEdge },
+  { "scrollToTopEdge",         0, true,  false, false, &XPDFViewer::cmdScrollToTopEdge },
+  { "scrollToTopLeft",         0, true,  false, false, &XPDFViewer::cmdScrollToTopLeft },
+  { "scrollUp",                1, true,  false, true,  &XPDFViewer::cmdScrollUp },
+  { "scrollUpPrevPage",        1, true,  false, false, &XPDFViewer::cmdScrollUpPrevPage },
+  { "search",                  1, true,  false, false, &XPDFViewer::cmdSearch },
+  { "setSelection",            5, true,  false, false, &XPDFViewer::cmdSetSelection },
+  { "singlePageMode",          0, false, false, false, &XPDFViewer::cmdSinglePageMode },
+  { "startPan",                0, true,  true,  false, &XPDFViewer::cmdStartPan },
+  { "startSelection",          0, true,  true,  false, &XPDFViewer::cmdStartSelection },
+  { "toggleContinuousMode",    0, false, false, false, &XPDFViewer::cmdToggleContinuousMode },
+  { "toggleFullScreenMode",    0, false, false, false, &XPDFViewer::cmdToggleFullScreenMode },
+  { "toggleOutline",           0, false, false, false, &XPDFViewer::cmdToggleOutline },
+  { "windowMode",              0, false, false, false, &XPDFViewer::cmdWindowMode },
+  { "zoomFitHeight",           0, false, false, false, &XPDFViewer::cmdZoomFitHeight },
+  { "zoomFitPage",             0, false, false, false, &XPDFViewer::cmdZoomFitPage },
+  { "zoomFitWidth",            0, false, false, false, &XPDFViewer::cmdZoomFitWidth },
+  { "zoomIn",                  0, false, false, false, &XPDFViewer::cmdZoomIn },
+  { "zoomOut",                 0, false, false, false, &XPDFViewer::cmdZoomOut },
+  { "zoomPercent",             1, false, false, false, &XPDFViewer::cmdZoomPercent },
+  { "zoomToSelection",         0, true,  false, false, &XPDFViewer::cmdZoomToSelection }
 };
 
 #define nCmds (sizeof(cmdTab) / sizeof(XPDFViewerCmd))
@@ -275,6 +275,7 @@ void XPDFViewer::init(XPDFApp *appA, PDFDoc *doc, const std::string *fileName,
   win = NULL;
   core = NULL;
   ok = false;
+  cmdRepeat = 1;
 #ifndef DISABLE_OUTLINE
   outlineLabels = NULL;
   outlineLabelsLength = outlineLabelsSize = 0;
@@ -513,7 +514,8 @@ void XPDFViewer::actionCbk(void *data, const char *action) {
 void XPDFViewer::keyPressCbk(void *data, KeySym key, unsigned int modifiers,
 			     XEvent *event) {
   XPDFViewer *viewer = (XPDFViewer *)data;
-  int keyCode;
+  int keyCode, repeat;
+  bool repeatable;
 
   if (key >= 0x20 && key <= 0xfe) {
     keyCode = (int)key;
@@ -568,14 +570,65 @@ void XPDFViewer::keyPressCbk(void *data, KeySym key, unsigned int modifiers,
     return;
   }
 
-  for (const auto& cmd: xpdfParams->getKeyBinding(
+  // if the key is being auto-repeated faster than the commands bound
+  // to it can be run, and they can all take several steps at once, the
+  // queued repeats are collapsed into one step
+  const StringList &cmds = xpdfParams->getKeyBinding(
 				keyCode,
 				viewer->getModifiers(modifiers),
-				viewer->getContext(modifiers))) {
-    viewer->execCmd(cmd, event);
+				viewer->getContext(modifiers));
+  repeatable = !cmds.empty() && event && event->type == KeyPress;
+  for (const auto& cmd: cmds) {
+    repeatable = repeatable && isRepeatableCmd(cmd);
+  }
+  repeat = repeatable ? collapseKeyRepeat(event) : 1;
+  for (const auto& cmd: cmds) {
+    viewer->execCmd(cmd, event, repeat);
   }
 }
 
+// Returns true if <next> is another press of the same key as <event>.
+static bool isKeyRepeat(XEvent *next, XEvent *event) {
+  return next->type == KeyPress &&
+         next->xkey.window == event->xkey.window &&
+         next->xkey.keycode == event->xkey.keycode &&
+         next->xkey.state == event->xkey.state;
+}
+
+// Remove the auto-repeats of <event>'s key from the head of the event
+// queue, and return the total number of presses (including <event>).
+// Without the server's detectable auto-repeat, each repeat arrives as
+// a KeyRelease immediately followed by a KeyPress.
+int XPDFViewer::collapseKeyRepeat(XEvent *event) {
+  Display *display;
+  XEvent release, next;
+  int n;
+
+  display = event->xkey.display;
+  n = 1;
+  while (XEventsQueued(display, QueuedAfterReading) > 0) {
+    XPeekEvent(display, &next);
+    if (next.type == KeyRelease && next.xkey.window == event->xkey.window &&
+	next.xkey.keycode == event->xkey.keycode) {
+      XNextEvent(display, &release);
+      if (XEventsQueued(display, QueuedAfterReading) == 0) {
+	XPutBackEvent(display, &release);
+	break;
+      }
+      XPeekEvent(display, &next);
+      if (!isKeyRepeat(&next, event)) {
+	XPutBackEvent(display, &release);
+	break;
+      }
+    } else if (!isKeyRepeat(&next, event)) {
+      break;
+    }
+    XNextEvent(display, &next);
+    ++n;
+  }
+  return n;
+}
+
 void XPDFViewer::mouseCbk(void *data, XEvent *event) {
   XPDFViewer *viewer = (XPDFViewer *)data;
   int keyCode;
@@ -636,11 +689,48 @@ int XPDFViewer::getContext(unsigned int modifiers) {
   return context;
 }
 
-void XPDFViewer::execCmd(const std::string& cmd, XEvent *event) {
+// Find a command in cmdTab; returns -1 if there is none.
+int XPDFViewer::findCmd(const std::string& name) {
+  int a, b, m, cmp;
+
+  a = -1;
+  b = nCmds;
+  cmp = 1;
+  // invariant: cmdTab[a].name < name < cmdTab[b].name
+  while (b - a > 1) {
+    m = (a + b) / 2;
+    cmp = strcmp(cmdTab[m].name, name.c_str());
+    if (cmp < 0) {
+      a = m;
+    } else if (cmp > 0) {
+      b = m;
+    } else {
+      a = b = m;
+    }
+  }
+  return cmp == 0 ? a : -1;
+}
+
+// Returns true if <cmd> (a command with its arguments) can take
+// several steps at once.
+bool XPDFViewer::isRepeatableCmd(const std::string& cmd) {
+  size_t n;
+  int a;
+
+  for (n = 0; n < cmd.size() && isalnum(cmd[n] & 0xff); ++n) ;
+  if ((a = findCmd(cmd.substr(0, n))) < 0) {
+    return false;
+  }
+  return cmdTab[a].repeatable;
+}
+
+// Execute a command.  A repeatable command takes <repeat> steps at
+// once; any other command ignores <repeat>.
+void XPDFViewer::execCmd(const std::string& cmd, XEvent *event, int repeat) {
   std::string name;
   CmdList args;
   const char *p0, *p1;
-  int a, b, m, cmp;
+  int a;
 
   //----- parse the command
   p0 = cmd.c_str();
@@ -668,21 +758,7 @@ void XPDFViewer::execCmd(const std::string& cmd, XEvent *event) {
   }
 
   //----- find the command
-  a = -1;
-  b = nCmds;
-  // invariant: cmdTab[a].name < name < cmdTab[b].name
-  while (b - a > 1) {
-    m = (a + b) / 2;
-    cmp = strcmp(cmdTab[m].name, name.c_str());
-    if (cmp < 0) {
-      a = m;
-    } else if (cmp > 0) {
-      b = m;
-    } else {
-      a = b = m;
-    }
-  }
-  if (cmp != 0) {
+  if ((a = findCmd(name)) < 0) {
     goto err1;
   }
 
@@ -696,7 +772,9 @@ void XPDFViewer::execCmd(const std::string& cmd, XEvent *event) {
     // clicking in a window with no open PDF file
     return;
   }
+  cmdRepeat = cmdTab[a].repeatable ? repeat : 1;
   (this->*cmdTab[a].func)(args, event);
+  cmdRepeat = 1;
 
   return;
 
@@ -911,11 +989,11 @@ void XPDFViewer::cmdGotoPageNoScroll(const CmdList& args, XEvent *event) {
 }
 
 void XPDFViewer::cmdNextPage(const CmdList& args, XEvent *event) {
-  core->gotoNextPage(1, true);
+  core->gotoNextPage(cmdRepeat, true);
 }
 
 void XPDFViewer::cmdNextPageNoScroll(const CmdList& args, XEvent *event) {
-  core->gotoNextPage(1, false);
+  core->gotoNextPage(cmdRepeat, false);
 }
 
 void XPDFViewer::cmdOpen(const CmdList& args, XEvent *event) {
@@ -989,11 +1067,11 @@ void XPDFViewer::cmdPostPopupMenu(const CmdList& args, XEvent *event) {
 }
 
 void XPDFViewer::cmdPrevPage(const CmdList& args, XEvent *event) {
-  core->gotoPrevPage(1, true, false);
+  core->gotoPrevPage(cmdRepeat, true, false);
 }
 
 void XPDFViewer::cmdPrevPageNoScroll(const CmdList& args, XEvent *event) {
-  core->gotoPrevPage(1, false, false);
+  core->gotoPrevPage(cmdRepeat, false, false);
 }
 
 void XPDFViewer::cmdPrint(const CmdList& args, XEvent *event) {
@@ -1143,7 +1221,7 @@ void XPDFViewer::cmdSaveAs(const CmdList& args, XEvent *event) {
 }
 
 void XPDFViewer::cmdScrollDown(const CmdList& args, XEvent *event) {
-  core->scrollDown(atoi(args[0].c_str()));
+  core->scrollDown(cmdRepeat * atoi(args[0].c_str()));
 }
 
 void XPDFViewer::cmdScrollDownNextPage(const CmdList& args, XEvent *event) {
@@ -1151,7 +1229,7 @@ void XPDFViewer::cmdScrollDownNextPage(const CmdList& args, XEvent *event) {
 }
 
 void XPDFViewer::cmdScrollLeft(const CmdList& args, XEvent *event) {
-  core->scrollLeft(atoi(args[0].c_str()));
+  core->scrollLeft(cmdRepeat * atoi(args[0].c_str()));
 }
 
 void XPDFViewer::cmdScrollOutlineDown(const CmdList& args, XEvent *event) {
@@ -1195,7 +1273,7 @@ void XPDFViewer::cmdScrollOutlineUp(const CmdList& args, XEvent *event) {
 }
 
 void XPDFViewer::cmdScrollRight(const CmdList& args, XEvent *event) {
-  core->scrollRight(atoi(args[0].c_str()));
+  core->scrollRight(cmdRepeat * atoi(args[0].c_str()));
 }
 
 void XPDFViewer::cmdScrollToBottomEdge(const CmdList& args, XEvent *event) {
@@ -1223,7 +1301,7 @@ void XPDFViewer::cmdScrollToTopLeft(const CmdList& args, XEvent *event) {
 }
 
 void XPDFViewer::cmdScrollUp(const CmdList& args, XEvent *event) {
-  core->scrollUp(atoi(args[0].c_str()));
+  core->scrollUp(cmdRepeat * atoi(args[0].c_str()));
 }
 
 void XPDFViewer::cmdScrollUpPrevPage(const CmdList& args, XEvent *event) {
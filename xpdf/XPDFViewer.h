@@ -56,6 +56,8 @@ struct XPDFViewerCmd {
   unsigned int nArgs;
   bool requiresDoc;
   bool requiresEvent;
+  bool repeatable;		// can take several steps at once (see
+				//   XPDFViewer::cmdRepeat)
   void (XPDFViewer::*func)(const CmdList& args, XEvent *event);
 };
 
@@ -81,7 +83,7 @@ public:
   void clear();
   void reloadFile();
 
-  void execCmd(const std::string& cmd, XEvent *event);
+  void execCmd(const std::string& cmd, XEvent *event, int repeat = 1);
 
   Widget getWindow() { return win; }
 
@@ -113,6 +115,9 @@ private:
   static void mouseCbk(void *data, XEvent *event);
   int getModifiers(unsigned int modifiers);
   int getContext(unsigned int modifiers);
+  static int findCmd(const std::string& name);
+  static bool isRepeatableCmd(const std::string& cmd);
+  static int collapseKeyRepeat(XEvent *event);
 
   //----- command functions
   void cmdAbout(const CmdList& args, XEvent *event);
@@ -322,6 +327,8 @@ private:
   XmFontList createFontList(char *xlfd);
 
   static XPDFViewerCmd cmdTab[];
+  int cmdRepeat;		// number of steps for the repeatable
+				//   command being executed
 
   XPDFApp *app;
   bool ok;